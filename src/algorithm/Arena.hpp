@@ -0,0 +1,181 @@
+/**
+ * A bump allocator for the scratch memory of the native entry points, shared by all modules.
+ *
+ * Memory is carved out of large chunks and is never returned to the heap in the middle of a call.
+ * Freed blocks go to per-size-class free lists (powers of two), so growing vectors and rehashing maps
+ * can reuse the memory within the same call. When the outermost `Scope` exits, the arena is reset and,
+ * if more than one chunk was needed, the chunks are coalesced into a single one large enough for the whole call,
+ * so that calls of a similar size afterwards perform no heap allocation at all.
+ *
+ * Usage:
+ * ```cpp
+ * void entry() {
+ *     Arena::Scope scope; // must be declared before any scratch container
+ *     Arena::ScratchVector<int> vec;
+ *     ...
+ * }
+ * ```
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "MemoryStats.hpp"
+
+namespace Arena {
+
+struct Stats {
+    /** total number of bytes of all chunks */
+    uint32_t capacity;
+    /** number of bytes handed out (excluding freed blocks) since the last reset */
+    uint32_t used;
+    /** the maximum of used ever reached */
+    uint32_t peak;
+    /** number of chunks allocated from the heap */
+    uint32_t heapAllocs;
+    /** number of times the arena is reset */
+    uint32_t resets;
+};
+
+/** blocks are at least 16 bytes (2^4), so that every block is 16-byte aligned */
+constexpr int MIN_CLASS = 4;
+constexpr int NUM_CLASSES = 32;
+constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+struct Chunk {
+    char* data;
+    size_t size;
+};
+
+/**
+ * the size class of a block: the smallest c such that 2^c >= bytes
+ */
+inline int sizeClass(size_t bytes) {
+    int c = MIN_CLASS;
+    while (((size_t)1 << c) < bytes) c++;
+    return c;
+}
+
+struct ScratchArena {
+    /** chunks[0 ... size - 2] are full, chunks.back() is the current chunk */
+    std::vector<Chunk> chunks;
+    /** offset of the first free byte in the current chunk */
+    size_t offset = 0;
+    /** singly-linked free lists of each size class. The next pointer is stored in the first bytes of a block */
+    void* freeLists[NUM_CLASSES] = {};
+    /** depth of nested scopes */
+    int depth = 0;
+    Stats stats = {};
+
+    void* alloc(size_t bytes) {
+        int c = sizeClass(bytes);
+        size_t size = (size_t)1 << c;
+        stats.used += size;
+        if (stats.used > stats.peak) stats.peak = stats.used;
+
+        if (freeLists[c] != NULL) {
+            void* block = freeLists[c];
+            freeLists[c] = *static_cast<void**>(block);
+            return block;
+        }
+        if (chunks.empty() || offset + size > chunks.back().size) {
+            addChunk(std::max(size, std::max(MIN_CHUNK_SIZE, (size_t)stats.capacity)));
+        }
+        void* block = chunks.back().data + offset;
+        offset += size;
+        return block;
+    }
+
+    void free(void* block, size_t bytes) {
+        int c = sizeClass(bytes);
+        stats.used -= (size_t)1 << c;
+        *static_cast<void**>(block) = freeLists[c];
+        freeLists[c] = block;
+    }
+
+    void addChunk(size_t size) {
+        char* data = static_cast<char*>(malloc(size));
+        // exceptions are disabled in production builds
+        if (data == NULL) abort();
+        chunks.push_back({data, size});
+        offset = 0;
+        stats.capacity += size;
+        stats.heapAllocs++;
+        MemoryStats::set(MemoryStats::scratchArena, stats.capacity);
+    }
+
+    void reset() {
+        if (chunks.size() > 1) {
+            size_t total = stats.capacity;
+            release();
+            addChunk(total);
+        }
+        offset = 0;
+        for (auto& list : freeLists) list = NULL;
+        stats.used = 0;
+        stats.resets++;
+    }
+
+    /**
+     * return all chunks to the heap
+     */
+    void release() {
+        for (auto& chunk : chunks) ::free(chunk.data);
+        chunks.clear();
+        chunks.shrink_to_fit();
+        offset = 0;
+        for (auto& list : freeLists) list = NULL;
+        stats.capacity = stats.used = 0;
+        MemoryStats::set(MemoryStats::scratchArena, 0);
+    }
+};
+
+inline ScratchArena scratch;
+
+/**
+ * marks an entry point that uses scratch memory. The arena is reset when the outermost scope exits
+ */
+struct Scope {
+    Scope() { scratch.depth++; }
+    ~Scope() {
+        if (--scratch.depth == 0) scratch.reset();
+    }
+};
+
+/**
+ * allocate an uninitialized array from the scratch arena. It lives until the outermost scope exits
+ */
+template <typename T>
+inline T* allocArray(size_t n) {
+    return static_cast<T*>(scratch.alloc(n * sizeof(T)));
+}
+
+/**
+ * STL allocator backed by the scratch arena
+ */
+template <typename T>
+struct ScratchAllocator {
+    using value_type = T;
+    ScratchAllocator() = default;
+    template <typename U>
+    ScratchAllocator(const ScratchAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(scratch.alloc(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        scratch.free(p, n * sizeof(T));
+    }
+    template <typename U>
+    bool operator==(const ScratchAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const ScratchAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+}  // namespace Arena
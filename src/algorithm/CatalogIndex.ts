@@ -0,0 +1,147 @@
+/**
+ * @module src/algorithm
+ */
+
+/**
+ *
+ */
+import CatalogDB from '../data/CatalogDB';
+import Catalog from '../models/Catalog';
+import { parseDate } from '../utils';
+import { TimeArray } from './ScheduleGenerator';
+import { traceEnd, traceStart } from './Trace';
+
+/** key of the catalog index in the blobs table of [[CatalogDB]] */
+const BLOB_KEY = 'catalogIndex';
+/** number of uint32 words of the header of the binary file. See `CatalogIndex::serialize` in ScheduleGenerator.cpp */
+const HEADER_WORDS = 8;
+/** the catalog whose sections are in the native catalog index */
+let indexedCatalog: Readonly<Catalog> | null = null;
+
+/**
+ * whether the native catalog index is built from the given catalog.
+ * The ids of the sections of different semesters may collide, so the index of another catalog must not be used
+ */
+export function hasCatalogIndex(catalog: Readonly<Catalog>) {
+    return indexedCatalog === catalog;
+}
+
+/**
+ * build the native catalog index, i.e. the table of the meetings, rooms and dates of all sections of the catalog
+ * and the conflicts between them. The generator gathers its inputs from the table instead of converting the sections
+ */
+export function buildCatalogIndex(catalog: Readonly<Catalog>) {
+    const Module = window.NativeModule;
+    const { sections } = catalog;
+    indexedCatalog = null;
+
+    // the rooms are matched against the buildings by getTimeRoom, so only do it once for the same meetings and rooms
+    const cache = new Map<string, TimeArray>();
+    const timeArrays = sections.map(sec => {
+        const key = sec.meetings.map(m => `${m.days}@${m.room}`).join('|');
+        let timeArray = cache.get(key);
+        if (!timeArray) cache.set(key, (timeArray = sec.getTimeRoom()));
+        return timeArray;
+    });
+
+    // the time array of each section has its own 8 offsets of the days
+    const offsetPtr = Module._malloc((sections.length + 1) * 4);
+    const offsets = Module.HEAPU32.subarray(offsetPtr / 4, offsetPtr / 4 + sections.length + 1);
+    let len = 0;
+    for (let i = 0; i < sections.length; i++) {
+        offsets[i] = len;
+        len += 8;
+        for (const day of timeArrays[i]) len += day.length;
+    }
+    offsets[sections.length] = len;
+    const timePtr = Module._malloc(len * 2);
+    const times = Module.HEAPU16.subarray(timePtr / 2, timePtr / 2 + len);
+    for (let i = 0; i < sections.length; i++) {
+        let offset = 0;
+        for (let k = 0; k < 7; k++) {
+            times[offsets[i] + k] = offset;
+            times.set(timeArrays[i][k], offsets[i] + 8 + offset);
+            offset += timeArrays[i][k].length;
+        }
+        times[offsets[i] + 7] = offset;
+    }
+
+    const idPtr = Module._malloc(sections.length * 4);
+    Module.HEAP32.set(
+        sections.map(s => s.id),
+        idPtr / 4
+    );
+    // [start, end] date in days. Sections with invalid dates are never generated, so their dates do not matter
+    const datePtr = Module._malloc(sections.length * 8);
+    const dates = Module.HEAP32.subarray(datePtr / 4, datePtr / 4 + sections.length * 2);
+    for (let i = 0; i < sections.length; i++) {
+        const date = parseDate(sections[i].dates);
+        if (!date) continue;
+        dates[2 * i] = Math.floor(date[0] / 864e5);
+        dates[2 * i + 1] = Math.floor(date[1] / 864e5);
+    }
+    Module._buildCatalogIndex(sections.length, idPtr, offsetPtr, timePtr, datePtr);
+    indexedCatalog = catalog;
+}
+
+/**
+ * @returns a copy of the binary file of the native catalog index
+ */
+export function exportCatalogIndex() {
+    const Module = window.NativeModule;
+    const ptr = Module._exportCatalogIndex();
+    return Module.HEAPU8.slice(ptr, ptr + Module.HEAPU32[ptr / 4 + 2] * 4);
+}
+
+/**
+ * load the native catalog index from a binary file produced by [[exportCatalogIndex]]
+ * @param catalog the catalog the file is built from
+ * @returns false if the file is malformed
+ */
+export function loadCatalogIndex(catalog: Readonly<Catalog>, file: Uint8Array) {
+    indexedCatalog = null;
+    if (file.byteLength < HEADER_WORDS * 4) return false;
+    const view = new DataView(file.buffer, file.byteOffset, file.byteLength);
+    // the length in words is the third word of the header
+    if (view.getUint32(8, true) * 4 !== file.byteLength) return false;
+
+    const Module = window.NativeModule;
+    const ptr = Module._malloc(file.byteLength);
+    Module.HEAPU8.set(file, ptr);
+    if (!Module._loadCatalogIndex(ptr)) return false;
+    indexedCatalog = catalog;
+    return true;
+}
+
+/**
+ * load the catalog index of the catalog from the database, or build it and save it to the database
+ * if it is missing or out of date. Errors are logged instead of thrown: without the index,
+ * the generator converts the sections itself
+ */
+export async function prepareCatalogIndex(catalog: Readonly<Catalog>) {
+    const db = new CatalogDB(catalog.semester);
+    const record = await db.blobs.get(BLOB_KEY).catch(err => {
+        console.warn('failed to read the catalog index', err);
+        return undefined;
+    });
+    // another catalog is selected in the meantime
+    if (window.catalog !== catalog) return;
+    const start = traceStart();
+    try {
+        if (
+            !record ||
+            record.time !== catalog.modified ||
+            !loadCatalogIndex(catalog, record.data)
+        ) {
+            buildCatalogIndex(catalog);
+            // the index is usable even if it cannot be saved (e.g. out of quota or in private mode)
+            await db.blobs
+                .put({ key: BLOB_KEY, time: catalog.modified, data: exportCatalogIndex() })
+                .catch(err => console.warn('failed to save the catalog index', err));
+        }
+    } catch (err) {
+        indexedCatalog = null;
+        console.error('failed to prepare the catalog index', err);
+    }
+    traceEnd('CatalogIndex.prepare', start);
+}
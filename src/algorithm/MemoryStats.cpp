@@ -0,0 +1,36 @@
+#include "MemoryStats.hpp"
+
+#include "Arena.hpp"
+
+namespace MemoryStats {
+
+extern "C" {
+
+/**
+ * @returns pointer to an array of NUM_CATEGORIES pairs of uint32: [live bytes, peak bytes] of each category
+ */
+const Usage* getMemoryUsage() {
+    return usage;
+}
+
+/**
+ * release caches and shrink buffers on demand
+ * @param flags bitwise OR of the ReleaseFlag values
+ */
+void releaseMemory(int flags) {
+    ScheduleGenerator::releaseMemory(flags);
+    Renderer::releaseMemory(flags);
+    Searcher::releaseMemory(flags);
+    // the arena can only be released when no scratch memory is in use
+    if ((flags & releaseScratch) && Arena::scratch.depth == 0) Arena::scratch.release();
+}
+
+/**
+ * @returns pointer to the statistics of the scratch arena: [capacity, used, peak, heapAllocs, resets], as uint32
+ */
+const Arena::Stats* getArenaStats() {
+    return &Arena::scratch.stats;
+}
+}
+
+}  // namespace MemoryStats
@@ -0,0 +1,93 @@
+/**
+ * Accounting of the memory held by the native modules, by category.
+ * Each module reports the size of its long-lived buffers whenever they are (re)allocated or freed,
+ * and the live size and the high-water mark of each category can be queried by `getMemoryUsage` (see MemoryStats.cpp).
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace MemoryStats {
+
+/**
+ * @note keep in sync with `memoryCategories` in MemoryStats.ts
+ */
+enum Category {
+    /** ScheduleGenerator: the array of generated schedules */
+    schedules = 0,
+    /** ScheduleGenerator: indices, coefficients and day pattern ids used for sorting */
+    evalMem,
+    /** ScheduleGenerator: cached coefficients of each sort function */
+    sortCoeffCache,
+    /** ScheduleGenerator: the walking distance matrix */
+    timeMatrix,
+    /** Renderer: schedule blocks and working buffers */
+    rendererBlocks,
+    /** Searcher: tokens, postings and tries of all searcher instances */
+    searcherIndex,
+    /** all modules: the scratch arena used for per-call working memory (see Arena.hpp) */
+    scratchArena,
+    /** ScheduleGenerator: the dictionary of day patterns and their metrics */
+    dayPatterns,
+    /** ScheduleGenerator: the section to schedule index and the filtered view */
+    sectionIndex,
+    /** ScheduleGenerator: the catalog-wide table of sections and their conflicts */
+    catalogIndex,
+    NUM_CATEGORIES
+};
+
+struct Usage {
+    /** number of bytes currently held */
+    uint32_t live;
+    /** the maximum of live ever reached */
+    uint32_t peak;
+};
+
+inline Usage usage[NUM_CATEGORIES];
+
+/**
+ * change the live size of a category by delta bytes
+ */
+inline void track(Category category, int64_t delta) {
+    auto& u = usage[category];
+    u.live += delta;
+    if (u.live > u.peak) u.peak = u.live;
+}
+
+/**
+ * set the live size of a category, used by buffers that are resized by realloc
+ */
+inline void set(Category category, uint32_t bytes) {
+    track(category, (int64_t)bytes - usage[category].live);
+}
+
+/**
+ * flags of `releaseMemory`
+ */
+enum ReleaseFlag {
+    /** drop the cached coefficients of the sort functions. They will be recomputed by the next sort */
+    releaseSortCache = 1,
+    /** shrink the schedule and evaluation buffers to fit the schedules currently generated */
+    shrinkSchedules = 2,
+    /** free the buffers of the renderer. They will be reallocated by the next compute */
+    releaseRenderer = 4,
+    /** free the per-call working buffers of the searcher */
+    releaseSearcher = 8,
+    /** return the chunks of the scratch arena to the heap */
+    releaseScratch = 16,
+    /** free the section to schedule index. It will be rebuilt by the next filterSchedules */
+    releaseSectionIndex = 32
+};
+
+}  // namespace MemoryStats
+
+// release functions implemented by each module, called by releaseMemory
+namespace ScheduleGenerator {
+void releaseMemory(int flags);
+}
+namespace Renderer {
+void releaseMemory(int flags);
+}
+namespace Searcher {
+void releaseMemory(int flags);
+}
@@ -0,0 +1,83 @@
+/**
+ * @module src/algorithm
+ * @author Hanzhi Zhou
+ */
+
+/**
+ * names of the memory categories tracked by the native modules
+ * @note keep in sync with `MemoryStats::Category` in MemoryStats.hpp
+ */
+export const memoryCategories = [
+    'schedules',
+    'evalMem',
+    'sortCoeffCache',
+    'timeMatrix',
+    'rendererBlocks',
+    'searcherIndex',
+    'scratchArena',
+    'dayPatterns',
+    'sectionIndex',
+    'catalogIndex'
+] as const;
+
+/**
+ * flags for [[releaseNativeMemory]]. They can be combined with bitwise OR
+ * @note keep in sync with `MemoryStats::ReleaseFlag` in MemoryStats.hpp
+ */
+export enum ReleaseFlag {
+    sortCache = 1,
+    shrinkSchedules = 2,
+    renderer = 4,
+    searcher = 8,
+    scratch = 16,
+    sectionIndex = 32,
+    all = 63
+}
+
+export type MemoryUsage = { [x in typeof memoryCategories[number]]: { live: number; peak: number } };
+
+/**
+ * @returns the number of bytes currently held by each category, and the high-water mark of each category
+ */
+export function getNativeMemoryUsage() {
+    const Module = window.NativeModule;
+    const ptr = Module._getMemoryUsage() / 4;
+    const usage = {} as MemoryUsage;
+    for (let i = 0; i < memoryCategories.length; i++) {
+        usage[memoryCategories[i]] = {
+            live: Module.HEAPU32[ptr + 2 * i],
+            peak: Module.HEAPU32[ptr + 2 * i + 1]
+        };
+    }
+    return usage;
+}
+
+/**
+ * a human-readable summary of the live memory of each category, e.g. `schedules: 12.3MB`
+ */
+export function formatNativeMemoryUsage(usage = getNativeMemoryUsage()) {
+    return memoryCategories
+        .map(name => `${name}: ${(usage[name].live / 1024 / 1024).toFixed(1)}MB`)
+        .join(', ');
+}
+
+/**
+ * @returns statistics of the scratch arena shared by the native modules (see Arena.hpp)
+ */
+export function getArenaStats() {
+    const Module = window.NativeModule;
+    const ptr = Module._getArenaStats() / 4;
+    const [capacity, used, peak, heapAllocs, resets] = Module.HEAPU32.subarray(ptr, ptr + 5);
+    return { capacity, used, peak, heapAllocs, resets };
+}
+
+/**
+ * release native caches and shrink native buffers
+ * @param flags a combination of [[ReleaseFlag]]
+ */
+export function releaseNativeMemory(flags: ReleaseFlag = ReleaseFlag.all) {
+    window.NativeModule._releaseMemory(flags);
+}
+
+// expose to the console for inspection
+(window as any).getNativeMemoryUsage = getNativeMemoryUsage;
@@ -5,9 +5,16 @@
 #include <climits>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <queue>
 #include <vector>
 
+#include "Arena.hpp"
+#include "MemoryStats.hpp"
+#include "Renderer.hpp"
+#include "Solver.hpp"
+#include "Trace.hpp"
+
 using namespace std;
 
 #define DOUBLE_EPS 1e-8
@@ -22,9 +29,75 @@ int isTolerance = 0;
 int dfsTolerance = 0;
 int LPIters = 50;
 double tFactor = 0.1;
+/**
+ * the time budget of the layout of a day in milliseconds.
+ * If positive, the stages of the layout are chosen by their predicted time instead of applyDFS and MILP
+ */
+double budget = 0.0;
 
 glp_smcp parm;
 
+/**
+ * the stages of the layout, each of which improves the result of the previous one
+ */
+enum Level : int8_t {
+    /** the width of each block is 1 / number of rooms */
+    initialWidths = 0,
+    /** expand the blocks to the maximum depth of their paths */
+    dfsExpansion,
+    /** maximize the widths of the components that are not fixed by LP, until they converge */
+    lpRefinement,
+    /** the MILP model over all blocks. Only available with EXTRA_MODELS */
+    milpModel
+};
+/**
+ * the lowest level reached by the layouts since the last setOptions, or -1 if nothing is laid out
+ */
+int8_t lowestLevel = -1;
+
+/**
+ * an online model of the time taken by a stage of the layout, by the size of its input.
+ * The sizes are bucketed by their log2, and the time per block of each bucket is a moving average of the measurements
+ */
+struct CostModel {
+    static constexpr int BUCKETS = 16;
+    double perBlock[BUCKETS] = {};
+    bool measured[BUCKETS] = {};
+
+    static int bucket(int n) {
+        return min(BUCKETS - 1, 31 - __builtin_clz(max(n, 1)));
+    }
+
+    /**
+     * @returns the predicted time in milliseconds for n blocks. If the bucket of n is not measured yet,
+     * the time per block of the largest smaller bucket is used. It is 0 if no smaller bucket is measured either,
+     * so that the stage is tried and measured
+     */
+    double predict(int n) const {
+        for (int b = bucket(n); b >= 0; b--) {
+            if (measured[b]) return perBlock[b] * n;
+        }
+        return 0.0;
+    }
+
+    void update(int n, double ms) {
+        int b = bucket(n);
+        double val = ms / max(n, 1);
+        perBlock[b] = measured[b] ? 0.75 * perBlock[b] + 0.25 * val : val;
+        measured[b] = true;
+    }
+};
+/** the cost models of DFS expansion by the number of blocks, LP by the size of the component, and MILP by the number of blocks */
+CostModel dfsCost, lpCost, milpCost;
+
+inline double elapsedMs(chrono::steady_clock::time_point since) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+inline void reach(Level level) {
+    lowestLevel = lowestLevel < 0 ? level : min(lowestLevel, (int8_t)level);
+}
+
 struct ScheduleBlock {
     /**
      * whether this block is movable/expandable
@@ -108,6 +181,7 @@ void sortByStartTime() {
  * @returns the total number of rooms
  */
 int intervalScheduling() {
+    TRACE_SPAN("Renderer::intervalScheduling");
     if (N == 0) return 0;
 
     sortByStartTime();
@@ -155,7 +229,7 @@ int intervalScheduling2() {
         if (diff == 0) return r1->depth - r2->depth > 0;
         return diff > 0;
     };
-    priority_queue<ScheduleBlock*, vector<ScheduleBlock*>, decltype(comp)>
+    priority_queue<ScheduleBlock*, Arena::ScratchVector<ScheduleBlock*>, decltype(comp)>
         queue(comp);
     queue.push(blocksReordered[0]);
 
@@ -178,17 +252,13 @@ int intervalScheduling2() {
 }
 #endif
 
-template <typename T>
-struct TimeEntry {
-    T startMin, endMin;
-};
-
 /**
  * for the array of schedule blocks provided, construct an adjacency list
  * to represent the conflicts between each pair of blocks
  */
 void constructAdjList(int total) {
-    auto* grouped = new vector<ScheduleBlock*>[total];
+    TRACE_SPAN("Renderer::constructAdjList");
+    Arena::ScratchVector<Arena::ScratchVector<ScheduleBlock*>> grouped(total);
     for (int i = 0; i < N; i++) {
         grouped[blocks[i].depth].push_back(&blocks[i]);
     }
@@ -197,7 +267,7 @@ void constructAdjList(int total) {
     }
     // int faster than int16_t
     // and int16_t will get implicitly promoted anyway
-    vector<TimeEntry<int>> ranges;
+    Arena::ScratchVector<TimeEntry<int>> ranges;
     for (int i = 1; i < total; i++) {
         for (auto block : grouped[i]) {
             ranges.resize(0);
@@ -223,7 +293,6 @@ void constructAdjList(int total) {
             }
         }
     }
-    delete[] grouped;
 }
 
 /**
@@ -298,6 +367,7 @@ bool DFSFindFixedNumerical(ScheduleBlock* start) {
 }
 
 void dfsWidthExpansion() {
+    TRACE_SPAN("Renderer::dfsWidthExpansion");
     sort(blocksReordered, blocksReordered + N,
          [](const ScheduleBlock* b1, const ScheduleBlock* b2) {
              return b2->depth < b1->depth;
@@ -328,69 +398,70 @@ inline void addConstraint(int auxVar, int structVar, double coeff) {
 #define L(x) 2 * (x) + 1
 #define W(x) 2 * (x) + 2
 
-void buildLPModel1(int NC) {
-    // map each event to an index (for structural vairable)
+/**
+ * LP model 1: maximize the common width w of the blocks of the component in blockBuffer[0, NC) such that
+ * each block is on the right of its non-fixed left neighbors (li >= lj + w) and between its fixed neighbors.
+ *
+ * It is solved without an LP solver. The left neighbors are of lower depths, so they form a DAG,
+ * and the smallest feasible li for a given w is the maximum over the paths ending at i of (the bound of the first block + k * w),
+ * where k is the number of edges of the path. So w <= (the right bound of i - A(i, k)) / (k + 1), where A(i, k) is the maximum
+ * left bound of the first blocks of the paths of k edges ending at i, which is computed for each k by dynamic programming.
+ * Each block is then placed at its smallest feasible left
+ */
+void solveLPModel1(int NC) {
+    Arena::Scope scope;
+    // the left neighbors come first
+    sort(blockBuffer, blockBuffer + NC, [](const ScheduleBlock* a, const ScheduleBlock* b) { return a->depth < b->depth; });
     for (int i = 0; i < NC; i++) {
-        idxMap[blockBuffer[i]->idx] = i + 1;
+        idxMap[blockBuffer[i]->idx] = i;
     }
-    // count the number of rows needed
-    int auxVar = 0;
-    for (int i = 0; i < NC; i++)
-        for (auto v : blockBuffer[i]->cleftN)
-            auxVar += !v->isFixed;
-    glp_prob* lp = glp_create_prob();
-    glp_set_obj_dir(lp, GLP_MAX);
-
-    // preallocate rows and cols
-    glp_add_cols(lp, NC + 1);
-    glp_add_rows(lp, auxVar + NC);
-
-    // index 0 is not used by glpk
-    ia.resize(1);
-    ja.resize(1);
-    ar.resize(1);
-    auxVar = 1;
+    auto* lo = Arena::allocArray<double>(NC);
+    auto* hi = Arena::allocArray<double>(NC);
+    auto* cur = Arena::allocArray<double>(NC);
+    auto* next = Arena::allocArray<double>(NC);
     for (int i = 0; i < NC; i++) {
         auto block = blockBuffer[i];
+        // li >= maxLeftFixed
         double maxLeftFixed = 0.0;
+        for (auto v : block->cleftN)
+            if (v->isFixed) maxLeftFixed = max(maxLeftFixed, v->left + v->width);
+        // li + w <= minRightFixed
         double minRightFixed = 1.0;
-        for (auto v : block->cleftN) {
-            if (v->isFixed)
-                maxLeftFixed = max(maxLeftFixed, v->left + v->width);
-            else {
-                // li >= lj + w
-                addConstraint(auxVar, i + 1, 1.0);
-                addConstraint(auxVar, idxMap[v->idx], -1.0);
-                addConstraint(auxVar, NC + 1, -1.0);
-                glp_set_row_bnds(lp, auxVar++, GLP_LO, 0.0, 0.0);
-            }
-        }
         for (auto v : block->crightN)
             if (v->isFixed) minRightFixed = min(v->left, minRightFixed);
-
-        // li + w <= minRightFixed
-        addConstraint(auxVar, i + 1, 1.0);
-        addConstraint(auxVar, NC + 1, 1.0);
-        glp_set_row_bnds(lp, auxVar++, GLP_UP, 0.0, minRightFixed);
-
-        // li >= maxLeftFixed
-        glp_set_col_bnds(lp, i + 1, GLP_LO, maxLeftFixed, 0.0);
-        glp_set_obj_coef(lp, i + 1, 0.0);
+        lo[i] = cur[i] = maxLeftFixed;
+        hi[i] = minRightFixed;
     }
-    // w >= 0
-    glp_set_col_bnds(lp, NC + 1, GLP_LO, 0.0, 1.0);
-    // argmax(w)
-    glp_set_obj_coef(lp, NC + 1, 1.0);
 
-    glp_load_matrix(lp, ia.size() - 1, ia.data(), ja.data(), ar.data());
-    glp_simplex(lp, &parm);
+    // 0 <= w <= 1
+    double width = 1.0;
+    constexpr double NONE = -numeric_limits<double>::infinity();
+    for (int k = 0;; k++) {
+        bool any = false;
+        for (int i = 0; i < NC; i++) {
+            if (cur[i] == NONE) continue;
+            any = true;
+            width = min(width, (hi[i] - cur[i]) / (k + 1));
+        }
+        if (!any) break;
+        // extend the paths by one edge
+        for (int i = 0; i < NC; i++) {
+            next[i] = NONE;
+            for (auto v : blockBuffer[i]->cleftN)
+                if (!v->isFixed) next[i] = max(next[i], cur[idxMap[v->idx]]);
+        }
+        swap(cur, next);
+    }
+    width = max(width, 0.0);
 
-    double width = glp_get_col_prim(lp, NC + 1);
     for (int i = 0; i < NC; i++) {
-        blockBuffer[i]->left = glp_get_col_prim(lp, i + 1);
-        blockBuffer[i]->width = width;
+        auto block = blockBuffer[i];
+        double left = lo[i];
+        for (auto v : block->cleftN)
+            if (!v->isFixed) left = max(left, v->left + width);
+        block->left = left;
+        block->width = width;
     }
-    glp_delete_prob(lp);
 }
 
 #ifdef EXTRA_MODELS
@@ -588,7 +659,11 @@ void buildLPModel3(int NC) {
     glp_delete_prob(lp);
 }
 
-void buildMILPModel(int total) {
+/**
+ * @param timeLimit the time limit of the solver in milliseconds
+ * @returns whether a solution is found. The left and width of the blocks are only assigned if it is
+ */
+bool buildMILPModel(int total, int timeLimit) {
 #define B(x) 3 * N + (x) + 1
     // count the number of rows needed
     int auxVar = 0;
@@ -661,17 +736,22 @@ void buildMILPModel(int total) {
     glp_init_iocp(&parm);
     parm.presolve = GLP_ON;
     parm.msg_lev = GLP_MSG_ERR;
-    parm.tm_lim = 2000;  // 2s time limit
+    parm.tm_lim = timeLimit;
     glp_intopt(lp, &parm);
 
-    for (int i = 0; i < N; i++) {
-        blocks[i].left = glp_mip_col_val(lp, 2 * i + 1);
-        blocks[i].width = glp_mip_col_val(lp, 2 * i + 2);
+    int status = glp_mip_status(lp);
+    bool found = status == GLP_OPT || status == GLP_FEAS;
+    if (found) {
+        for (int i = 0; i < N; i++) {
+            blocks[i].left = glp_mip_col_val(lp, 2 * i + 1);
+            blocks[i].width = glp_mip_col_val(lp, 2 * i + 2);
+        }
     }
     glp_delete_prob(lp);
+    return found;
 }
 void (*LPModels[])(int idx) = {
-    buildLPModel1,
+    solveLPModel1,
     buildLPModel2,
     buildLPModel3};
 #endif
@@ -693,33 +773,35 @@ inline int getFixedCount(ScheduleBlock* end) {
     return fixedCount;
 }
 
-// disable name-mangling for exported functions
-extern "C" {
-
-void setOptions(int _isTolerance, int _ISMethod, int _applyDFS,
-                int _dfsTolerance, int _LPIters, int _LPModel, int _MILP, double _tFactor) {
-    isTolerance = _isTolerance;
-    ISMethod = _ISMethod;
-    applyDFS = _applyDFS;
-    dfsTolerance = _dfsTolerance;
-    LPIters = _LPIters;
-    LPModel = _LPModel;
-    MILP = _MILP;
-    tFactor = _tFactor;
-
-    glp_init_smcp(&parm);
-    parm.msg_lev = GLP_MSG_ERR;
+void releaseMemory(int flags) {
+    if (!(flags & MemoryStats::releaseRenderer)) return;
+    for (int i = 0; i < maxN; i++) blocks[i].~ScheduleBlock();
+    free(blocks);
+    free(blocksReordered);
+    free(blockBuffer);
+    free(idxMap);
+    blocks = NULL;
+    blocksReordered = blockBuffer = NULL;
+    idxMap = NULL;
+    maxN = N = 0;
+    MemoryStats::set(MemoryStats::rendererBlocks, 0);
+
+    ia = vector<int>();
+    ja = vector<int>();
+    ar = vector<double>();
 }
 
 /**
  * compute the width and left of the blocks
- * @param arr the array of start/end times of the blocks. It will be freed before this function returns.
+ * @param arr the array of start/end times of the blocks
  * @param N the number of blocks
+ * @returns the blocks in the same order as arr, or NULL if out of memory
  */
-ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
-#ifdef DEBUG_LOG
-    auto t1 = chrono::high_resolution_clock::now();
-#endif
+ScheduleBlock* computeBlocks(const TimeEntry<int16_t>* arr, int _N) {
+    TRACE_SPAN("Renderer::compute");
+    auto startTime = chrono::steady_clock::now();
+    Arena::Scope scope;
+    TRACE_COUNTER("Renderer::N", _N);
     // ---------------------------- setup --------------------------------------
     N = _N;
     if (N > maxN) {
@@ -745,6 +827,7 @@ ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
         if (!newMem) return NULL;
         idxMap = static_cast<int*>(newMem);
         maxN = N;
+        MemoryStats::set(MemoryStats::rendererBlocks, maxN * (sizeof(ScheduleBlock) + 2 * sizeof(ScheduleBlock*) + sizeof(int)));
     }
     r_sumSq = r_sum = 0.0;
 
@@ -766,14 +849,21 @@ ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
         block.cleftN.resize(0);
         block.crightN.resize(0);
     }
-    // free the input memory
-    free((void*)arr);
     // ---------------------------- end setup --------------------------------------
 
+    const bool budgeted = budget > 0;
+    // whether a stage predicted to take ms milliseconds can be finished in the remaining budget
+    auto fits = [&](double ms) { return elapsedMs(startTime) + ms <= budget; };
+    auto end = blocks + N;
 #ifdef EXTRA_MODELS
     int total = ISMethod == 1 ? intervalScheduling() : intervalScheduling2();
-    if (MILP) {
-        buildMILPModel(total);
+    if (MILP && !budgeted && Solver::available) {
+        if (buildMILPModel(total, 2000))  // 2s time limit
+            reach(milpModel);
+        else {
+            computeInitialWidth(end, total);
+            reach(initialWidths);
+        }
         computeResult();
         return blocks;
     }
@@ -782,31 +872,30 @@ ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
     int total = intervalScheduling();
 #endif
 
-    auto end = blocks + N;
     if (total <= 1) {
         computeInitialWidth(end, total);
+        // nothing can be improved
+        reach(milpModel);
         computeResult();
         return blocks;
     }
     // STEP 2
     constructAdjList(total);
     // STEP 3
-    if (applyDFS) {  // STEP 4
+    Level level = initialWidths;
+    if (budgeted ? fits(dfsCost.predict(N)) : applyDFS) {  // STEP 4
+        auto t = chrono::steady_clock::now();
         dfsWidthExpansion();
         for (auto* node = blocks; node < end; node++)
             node->visited = false;
+        dfsCost.update(N, elapsedMs(t));
+        level = dfsExpansion;
     } else {
         computeInitialWidth(end, total);
     }
 
-#ifdef DEBUG_LOG
-    auto t2 = chrono::high_resolution_clock::now();
-    auto time_span = chrono::duration_cast<chrono::duration<double>>(t2 - t1);
-    cout << "non-LP part took " << time_span.count() * 1000 << " ms" << endl;
-
-    t1 = chrono::high_resolution_clock::now();
-#endif
     // STEP 5
+    TRACE_SPAN("Renderer::LP");
     for (auto* block = blocks; block < end; block++) {
         if (block->visited) continue;
         double right = block->left + block->width;
@@ -814,6 +903,8 @@ ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
             DFSFindFixedNumerical(block);
     }
     int prevFixedCount = getFixedCount(end);
+    // whether the LP of a component is skipped because it does not fit in the budget
+    bool skipped = false;
     int i;
     for (i = 0; i < LPIters; i++) {
         // for each non-fixed component
@@ -821,11 +912,19 @@ ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
             if (!block->visited)  {
                 // build and solve the lp model
                 int NC = BFS(block);
+                // the component keeps its current widths, which are still valid
+                if (budgeted && !fits(lpCost.predict(NC))) {
+                    skipped = true;
+                    continue;
+                }
+                auto t = chrono::steady_clock::now();
                 #ifdef EXTRA_MODELS
-                    LPModels[LPModel - 1](NC);
+                    // the other models need GLPK. Use model 1 until it is loaded
+                    LPModels[Solver::available ? LPModel - 1 : 0](NC);
                 #else
-                    buildLPModel1(NC);
+                    solveLPModel1(NC);
                 #endif
+                lpCost.update(NC, elapsedMs(t));
             }
         }
         // reset the visited flag because DFSFindFixedNumerical also needs it
@@ -851,15 +950,91 @@ ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
             break;
         prevFixedCount = fixedCount;
     }
+    TRACE_COUNTER("Renderer::LPIters", i);
+    TRACE_COUNTER("Renderer::unfixed", N - prevFixedCount);
 #ifdef DEBUG_LOG
-    t2 = chrono::high_resolution_clock::now();
-    time_span = chrono::duration_cast<chrono::duration<double>>(t2 - t1);
-    cout << "convergence reached at " << i << " | " << N - prevFixedCount << " | " << time_span.count() * 1000 << " ms" << endl;
+    cout << "convergence reached at " << i << " | " << N - prevFixedCount << endl;
 #endif
+    if (LPIters > 0 && !skipped) level = lpRefinement;
+#ifdef EXTRA_MODELS
+    if (budgeted && level == lpRefinement && Solver::available && fits(milpCost.predict(N))) {
+        auto t = chrono::steady_clock::now();
+        // the MILP model needs the blocks sorted by their start times, which are reordered by DFS
+        sortByStartTime();
+        // the time limit of GLPK is in whole milliseconds
+        if (buildMILPModel(total, max(1, (int)(budget - elapsedMs(startTime))))) level = milpModel;
+        milpCost.update(N, elapsedMs(t));
+    }
+#endif
+    TRACE_COUNTER("Renderer::level", level);
+    reach(level);
     computeResult();
     return blocks;
 }
 
+bool layout(const TimeEntry<int16_t>* arr, int N, double* out) {
+    auto* result = computeBlocks(arr, N);
+    if (result == NULL) return false;
+    for (int i = 0; i < N; i++) {
+        out[2 * i] = result[i].left;
+        out[2 * i + 1] = result[i].width;
+    }
+    return true;
+}
+
+// disable name-mangling for exported functions
+extern "C" {
+
+/**
+ * @param _budget the time budget of the layout of a day in milliseconds.
+ * If positive, _applyDFS and _MILP are ignored, and the best stages that can be finished in time are applied instead
+ */
+void setOptions(int _isTolerance, int _ISMethod, int _applyDFS,
+                int _dfsTolerance, int _LPIters, int _LPModel, int _MILP, double _tFactor, double _budget) {
+    isTolerance = _isTolerance;
+    ISMethod = _ISMethod;
+    applyDFS = _applyDFS;
+    dfsTolerance = _dfsTolerance;
+    LPIters = _LPIters;
+    LPModel = _LPModel;
+    MILP = _MILP;
+    tFactor = _tFactor;
+    budget = _budget;
+    lowestLevel = -1;
+
+    if (Solver::available) {
+        glp_init_smcp(&parm);
+        parm.msg_lev = GLP_MSG_ERR;
+    }
+}
+
+/**
+ * called by loadSolver (see Solver.ts) after the GLPK side module is loaded
+ */
+void setSolverAvailable() {
+    Solver::available = true;
+    glp_init_smcp(&parm);
+    parm.msg_lev = GLP_MSG_ERR;
+}
+
+/**
+ * compute the width and left of the blocks
+ * @param arr the array of start/end times of the blocks. It will be freed before this function returns.
+ * @param N the number of blocks
+ */
+ScheduleBlock* compute(const TimeEntry<int16_t>* arr, int _N) {
+    auto* result = computeBlocks(arr, _N);
+    // free the input memory
+    free((void*)arr);
+    return result;
+}
+
+/**
+ * @returns the lowest level (see Renderer::Level) reached by the layouts since the last setOptions,
+ * i.e. the layout of each day is at least as good as this level. -1 if nothing is laid out
+ */
+int getLevel() { return lowestLevel; }
+
 double getSum() { return r_sum; }
 double getSumSq() { return r_sumSq; }
 }
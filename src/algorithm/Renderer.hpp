@@ -0,0 +1,27 @@
+/**
+ * The interface of the Renderer used by the other native modules (see Renderer.cpp).
+ *
+ * The generator lays out the blocks of its schedules with `layout` directly,
+ * so that they do not have to be decoded and copied back into the module by the caller of `compute`.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace Renderer {
+
+template <typename T>
+struct TimeEntry {
+    T startMin, endMin;
+};
+
+/**
+ * compute the width and left of the blocks of a day, in the same way as `compute`
+ * @param arr the array of start/end times of the blocks. Unlike `compute`, it is not freed
+ * @param N the number of blocks
+ * @param out output, the (left, width) of each block
+ * @returns false if out of memory
+ */
+bool layout(const TimeEntry<int16_t>* arr, int N, double* out);
+
+}  // namespace Renderer
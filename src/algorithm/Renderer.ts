@@ -8,6 +8,8 @@
  *
  */
 import { ScheduleDays } from '@/models/Schedule';
+import { loadSolver, solverLoaded } from './Solver';
+import { traceEnd, traceStart } from './Trace';
 
 export const options = {
     isTolerance: 0,
@@ -18,16 +20,60 @@ export const options = {
     LPModel: 1,
     showFixed: false,
     MILP: false,
-    tFactor: 0.1
+    tFactor: 0.1,
+    /**
+     * the time budget of the layout of each day in milliseconds. If positive, the renderer chooses the best method
+     * that can be finished in time, and `applyDFS` and `MILP` are ignored
+     */
+    budget: 0
+};
+
+/** the names of the levels of the layout reported by the renderer */
+export const layoutLevels = ['initial widths', 'DFS expansion', 'LP refinement', 'MILP'];
+
+export const layoutStats = {
+    /**
+     * the lowest level (index of [[layoutLevels]]) reached by the layouts of the days of the last schedule rendered,
+     * or -1 if no block is laid out
+     */
+    level: -1
 };
 
 /**
- * compute the width and left of the blocks contained in each day
+ * a schedule at an index of the native view of the generated schedules
  */
-export async function computeBlockPositions(days: ScheduleDays) {
-    const Module = window.NativeModule;
+export interface NativeViewRef {
+    idx: number;
+    /** the index is only valid in the version of the view it is taken from */
+    version: number;
+}
+
+/** incremented whenever the schedules in the native view or their order change */
+let viewVersion = 0;
+
+/**
+ * invalidate the [[NativeViewRef]]s taken so far, as the native view is regenerated, sorted or filtered
+ */
+export function invalidateNativeView() {
+    viewVersion++;
+}
+
+/**
+ * @returns the reference to the schedule at idx of the current native view
+ */
+export function nativeViewRef(idx: number): NativeViewRef {
+    return { idx, version: viewVersion };
+}
+
+/**
+ * whether the options may use the solver, i.e. the LP models other than the first one,
+ * which is solved without it, the MILP model, or the MILP level of the budget
+ */
+function needsSolver() {
+    return options.LPModel !== 1 || options.MILP || options.budget > 0;
+}
 
-    console.time('native compute');
+function setNativeOptions(Module: typeof window.NativeModule) {
     Module._setOptions(
         options.isTolerance,
         options.ISMethod,
@@ -36,8 +82,60 @@ export async function computeBlockPositions(days: ScheduleDays) {
         options.LPIters,
         options.LPModel,
         +options.MILP,
-        options.tFactor
+        options.tFactor,
+        options.budget
     );
+}
+
+/**
+ * compute the width and left of the blocks contained in each day from the day patterns of a generated schedule,
+ * which are laid out natively together with the events without copying the blocks into the native module
+ * @returns false if the layout cannot be used, in which case [[computeBlockPositions]] should be used instead:
+ * the view has changed since the schedule is taken from it,
+ * or the blocks differ from those of the native schedule (e.g. a date range is selected or a section is previewed)
+ */
+export function computeNativeBlockPositions(days: ScheduleDays, ref: NativeViewRef) {
+    if (ref.version !== viewVersion || options.showFixed) return false;
+    // the layout has to wait for the solver
+    if (needsSolver() && !solverLoaded()) return false;
+    const Module = window.NativeModule;
+    setNativeOptions(Module);
+    const ptr = Module._renderSchedule(ref.idx) / 8;
+    if (ptr === 0) return false;
+    const offsets = Module.HEAPF64.subarray(ptr, ptr + 8);
+    // blocks with the same start and end are interchangeable, so pair the blocks with the layouts by their times
+    const byTime = (a: number[], b: number[]) => a[0] - b[0] || a[1] - b[1];
+    for (let i = 0; i < 7; i++) {
+        const blocks = days[i];
+        const len = offsets[i + 1] - offsets[i];
+        if (len !== blocks.length) return false;
+
+        const base = ptr + 8 + offsets[i] * 4;
+        const layouts = Module.HEAPF64.subarray(base, base + len * 4);
+        const order = blocks.map((b, j) => [b.startMin, b.endMin, j]).sort(byTime);
+        const native: number[][] = [];
+        for (let j = 0; j < len; j++) native.push([layouts[4 * j], layouts[4 * j + 1], j]);
+        native.sort(byTime);
+        for (let j = 0; j < len; j++) {
+            if (order[j][0] !== native[j][0] || order[j][1] !== native[j][1]) return false;
+            const block = blocks[order[j][2]];
+            block.left = layouts[4 * native[j][2] + 2];
+            block.width = layouts[4 * native[j][2] + 3];
+        }
+    }
+    layoutStats.level = Module._getLevel();
+    return true;
+}
+
+/**
+ * compute the width and left of the blocks contained in each day
+ */
+export async function computeBlockPositions(days: ScheduleDays) {
+    if (needsSolver()) await loadSolver();
+    const Module = window.NativeModule;
+
+    const start = traceStart();
+    setNativeOptions(Module);
     let N = 0;
     let sum = 0;
     let sumSq = 0;
@@ -86,6 +184,7 @@ export async function computeBlockPositions(days: ScheduleDays) {
             }
         }
     }
+    layoutStats.level = Module._getLevel();
     if (N > 0) console.log('mean', sum / N, 'variance', sumSq / N - (sum / N) ** 2);
-    console.timeEnd('native compute');
+    traceEnd('Renderer.computeBlockPositions', start);
 }
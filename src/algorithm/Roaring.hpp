@@ -0,0 +1,247 @@
+/**
+ * A compressed bitmap of uint32 values in the style of Roaring bitmaps, used by the section index of ScheduleGenerator.
+ *
+ * Values are grouped by their high 16 bits into containers. A container stores the low 16 bits of its values
+ * either as a sorted array, when it holds no more than ARRAY_MAX values, or as a bitmap of 2^16 bits otherwise.
+ * Sparse sets thus take 2 bytes per value and dense sets take 1 bit per value,
+ * and the set operations work on whole words of the bitmaps where possible.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace Roaring {
+
+/** maximum number of values of an array container */
+constexpr uint32_t ARRAY_MAX = 4096;
+/** number of 64-bit words of a bitmap container */
+constexpr int BITMAP_WORDS = (1 << 16) / 64;
+
+struct Container {
+    /** the high 16 bits of the values in this container */
+    uint16_t key;
+    /** number of values in this container */
+    uint32_t card = 0;
+    /** the sorted low 16 bits of the values. Only used if bits is empty */
+    std::vector<uint16_t> array;
+    /** BITMAP_WORDS words of the bitmap, or empty if this is an array container */
+    std::vector<uint64_t> bits;
+
+    Container(uint16_t key) : key(key) {}
+
+    bool isBitmap() const { return !bits.empty(); }
+
+    bool contains(uint16_t v) const {
+        if (isBitmap()) return (bits[v >> 6] >> (v & 63)) & 1;
+        return std::binary_search(array.begin(), array.end(), v);
+    }
+
+    /**
+     * add a value greater than all values in this container
+     */
+    void append(uint16_t v) {
+        card++;
+        if (isBitmap()) {
+            bits[v >> 6] |= 1ull << (v & 63);
+        } else {
+            array.push_back(v);
+            if (card > ARRAY_MAX) toBitmap();
+        }
+    }
+
+    void toBitmap() {
+        bits.assign(BITMAP_WORDS, 0);
+        for (auto v : array) bits[v >> 6] |= 1ull << (v & 63);
+        array.clear();
+        array.shrink_to_fit();
+    }
+
+    /**
+     * recount the values after the bits are modified, and convert to an array container if it is sparse enough
+     */
+    void optimize() {
+        if (!isBitmap()) {
+            card = array.size();
+            return;
+        }
+        card = 0;
+        for (auto w : bits) card += __builtin_popcountll(w);
+        if (card > ARRAY_MAX) return;
+        array.reserve(card);
+        forEach([this](uint16_t v) { array.push_back(v); });
+        bits.clear();
+        bits.shrink_to_fit();
+    }
+
+    /**
+     * call f with each value (the low 16 bits) in ascending order
+     */
+    template <typename F>
+    void forEach(F f) const {
+        if (!isBitmap()) {
+            for (auto v : array) f(v);
+            return;
+        }
+        for (int i = 0; i < BITMAP_WORDS; i++) {
+            for (uint64_t w = bits[i]; w != 0; w &= w - 1) f((uint16_t)(i * 64 + __builtin_ctzll(w)));
+        }
+    }
+
+    size_t bytes() const {
+        return sizeof(Container) + array.capacity() * sizeof(uint16_t) + bits.capacity() * sizeof(uint64_t);
+    }
+};
+
+struct Bitmap {
+    /** containers sorted by their keys. Empty containers are not stored */
+    std::vector<Container> containers;
+
+    /**
+     * add a value greater than all values in this bitmap
+     */
+    void append(uint32_t v) {
+        uint16_t key = v >> 16;
+        if (containers.empty() || containers.back().key != key) containers.emplace_back(key);
+        containers.back().append(v & 0xFFFF);
+    }
+
+    uint32_t cardinality() const {
+        uint32_t card = 0;
+        for (auto& c : containers) card += c.card;
+        return card;
+    }
+
+    /**
+     * call f with each value in ascending order
+     */
+    template <typename F>
+    void forEach(F f) const {
+        for (auto& c : containers) {
+            uint32_t high = (uint32_t)c.key << 16;
+            c.forEach([&](uint16_t v) { f(high | v); });
+        }
+    }
+
+    size_t bytes() const {
+        size_t total = containers.capacity() * sizeof(Container);
+        for (auto& c : containers) total += c.bytes() - sizeof(Container);
+        return total;
+    }
+};
+
+/**
+ * @returns the bitmap of the values [0, n)
+ */
+inline Bitmap range(uint32_t n) {
+    Bitmap result;
+    for (uint32_t lo = 0; lo < n; lo += 1 << 16) {
+        uint32_t len = std::min(n - lo, (uint32_t)1 << 16);
+        Container c(lo >> 16);
+        c.bits.assign(BITMAP_WORDS, 0);
+        for (uint32_t i = 0; i < len / 64; i++) c.bits[i] = ~0ull;
+        if (len % 64) c.bits[len / 64] = (1ull << (len % 64)) - 1;
+        c.optimize();
+        result.containers.push_back(std::move(c));
+    }
+    return result;
+}
+
+inline Container intersect(const Container& a, const Container& b) {
+    Container result(a.key);
+    if (a.isBitmap() && b.isBitmap()) {
+        result.bits.resize(BITMAP_WORDS);
+        for (int i = 0; i < BITMAP_WORDS; i++) result.bits[i] = a.bits[i] & b.bits[i];
+    } else if (!a.isBitmap() && !b.isBitmap()) {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result.array));
+    } else {
+        const auto& arr = a.isBitmap() ? b : a;
+        const auto& bitmap = a.isBitmap() ? a : b;
+        for (auto v : arr.array) {
+            if (bitmap.contains(v)) result.array.push_back(v);
+        }
+    }
+    result.optimize();
+    return result;
+}
+
+inline Container unite(const Container& a, const Container& b) {
+    Container result(a.key);
+    if (!a.isBitmap() && !b.isBitmap()) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result.array));
+        if (result.array.size() > ARRAY_MAX) result.toBitmap();
+    } else {
+        const auto& bitmap = a.isBitmap() ? a : b;
+        const auto& other = a.isBitmap() ? b : a;
+        result.bits = bitmap.bits;
+        if (other.isBitmap()) {
+            for (int i = 0; i < BITMAP_WORDS; i++) result.bits[i] |= other.bits[i];
+        } else {
+            for (auto v : other.array) result.bits[v >> 6] |= 1ull << (v & 63);
+        }
+    }
+    result.optimize();
+    return result;
+}
+
+/**
+ * @returns the values in a but not in b
+ */
+inline Container subtract(const Container& a, const Container& b) {
+    Container result(a.key);
+    if (!a.isBitmap()) {
+        for (auto v : a.array) {
+            if (!b.contains(v)) result.array.push_back(v);
+        }
+    } else {
+        result.bits = a.bits;
+        if (b.isBitmap()) {
+            for (int i = 0; i < BITMAP_WORDS; i++) result.bits[i] &= ~b.bits[i];
+        } else {
+            for (auto v : b.array) result.bits[v >> 6] &= ~(1ull << (v & 63));
+        }
+    }
+    result.optimize();
+    return result;
+}
+
+/**
+ * merge the containers of a and b by their keys
+ * @param both combines two containers of the same key
+ * @param keepA whether to keep the containers only in a
+ * @param keepB whether to keep the containers only in b
+ */
+template <typename F>
+inline Bitmap merge(const Bitmap& a, const Bitmap& b, F both, bool keepA, bool keepB) {
+    Bitmap result;
+    size_t i = 0, j = 0;
+    while (i < a.containers.size() || j < b.containers.size()) {
+        if (j == b.containers.size() || (i < a.containers.size() && a.containers[i].key < b.containers[j].key)) {
+            if (keepA) result.containers.push_back(a.containers[i]);
+            i++;
+        } else if (i == a.containers.size() || b.containers[j].key < a.containers[i].key) {
+            if (keepB) result.containers.push_back(b.containers[j]);
+            j++;
+        } else {
+            auto c = both(a.containers[i++], b.containers[j++]);
+            if (c.card > 0) result.containers.push_back(std::move(c));
+        }
+    }
+    return result;
+}
+
+inline Bitmap intersect(const Bitmap& a, const Bitmap& b) {
+    return merge(a, b, [](const Container& x, const Container& y) { return intersect(x, y); }, false, false);
+}
+
+inline Bitmap unite(const Bitmap& a, const Bitmap& b) {
+    return merge(a, b, [](const Container& x, const Container& y) { return unite(x, y); }, true, true);
+}
+
+inline Bitmap subtract(const Bitmap& a, const Bitmap& b) {
+    return merge(a, b, [](const Container& x, const Container& y) { return subtract(x, y); }, true, false);
+}
+
+}  // namespace Roaring
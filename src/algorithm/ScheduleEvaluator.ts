@@ -8,7 +8,9 @@
  */
 import GeneratedSchedule from '../models/GeneratedSchedule';
 import Event from '../models/Event';
-import { RawAlgoCourse } from './ScheduleGenerator';
+import { PrunedSection, RawAlgoCourse } from './ScheduleGenerator';
+import { invalidateNativeView, nativeViewRef } from './Renderer';
+import { traceEnd, traceStart } from './Trace';
 
 // eslint-disable-next-line @typescript-eslint/no-use-before-define
 export type SortFunctionNames =
@@ -47,12 +49,127 @@ export interface EvaluatorOptions {
     readonly sortBy: readonly SortOption[];
     mode: SortMode;
 }
+/**
+ * flags of [[ScheduleEvaluator.getPage]]
+ * @note keep in sync with `ExportFlag` in ScheduleGenerator.cpp
+ */
+export enum ExportFlag {
+    sections = 0,
+    blocks = 1,
+    metrics = 2
+}
+
+/**
+ * a page of sorted schedules exported in one native call. The arrays are views into the native memory,
+ * valid until the next call of [[ScheduleEvaluator.getPage]]
+ */
+export interface SchedulePage {
+    /** number of schedules in this page */
+    count: number;
+    /** indices (in the classList) of the sections of each schedule. The i-th schedule is at [i * numCourses, (i + 1) * numCourses) */
+    sections: Uint16Array;
+    /** value of each sort function (in the order of their idx, excluding IamFeelingLucky) of each schedule. NaN if not available */
+    metrics?: Float32Array;
+    /** the blocks of the i-th schedule are at blocks[blockOffsets[i] ... blockOffsets[i + 1]) */
+    blockOffsets?: Int32Array;
+    /** the day blocks of the schedules: 8 offsets followed by (start, end, room) triples */
+    blocks?: Uint16Array;
+}
+
+/**
+ * operators of the clauses of [[ScheduleEvaluator.filter]]
+ * @note keep in sync with `FilterOp` in ScheduleGenerator.cpp
+ */
+export enum FilterOp {
+    /** keep the schedules containing all of the sections */
+    include = 0,
+    /** keep the schedules containing none of the sections */
+    exclude = 1,
+    /** keep the schedules containing at least one of the sections */
+    anyOf = 2
+}
+
+/**
+ * a clause of [[ScheduleEvaluator.filter]]
+ */
+export interface ScheduleFilter {
+    op: FilterOp;
+    /** ids of the sections */
+    sections: number[];
+}
+
+/** number of schedules fetched at once by getSchedule */
+const PAGE_SIZE = 64;
+/** number of schedules ranked by the preview of a progressive sort */
+const PREVIEW_SAMPLES = 2048;
+/** views with fewer schedules than this are always sorted at once */
+const PROGRESSIVE_SORT_MIN = 200000;
+/** time budget of each slice of the exact sort after the preview, in milliseconds */
+const SORT_SLICE = 12;
+/** the handle of the next slice of the exact sort in progress. There's only one native view, so one sort at a time */
+let sortTimer = 0;
+
+/**
+ * encode the reference schedule as the index of the referenced section of each course, or 65535 if there is none
+ * @param out the output array of length = number of courses
+ */
+export function encodeRefSchedule(
+    refSchedule: GeneratedSchedule['All'],
+    classList: RawAlgoCourse[],
+    secLens: number[],
+    out: Uint16Array
+) {
+    const numCourses = secLens.length - 1;
+    out.fill(65535);
+    for (const key in refSchedule) {
+        // all section ids of the course with key=key in the reference schedule
+        const refSecs = refSchedule[key].reduce<number[]>((acc, x) => {
+            for (const id of x) acc.push(id);
+            return acc;
+        }, []);
+        for (let i = 0; i < numCourses; i++) {
+            for (let j = secLens[i]; j < secLens[i + 1]; j++) {
+                const secs = classList[j];
+                if (secs[0] === key && refSecs.some(id => secs[1].includes(id))) {
+                    out[i] = j;
+                    break;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * pass the sort mode and the sort options to the native module
+ */
+export function setNativeSortOptions(Module: typeof window.NativeModule, options: EvaluatorOptions) {
+    Module._setSortMode(options.mode);
+
+    // keep the order (!important!)
+    for (let i = 0; i < options.sortBy.length; i++) {
+        const option = options.sortBy[i];
+        Module._setSortOption(i, +option.enabled, +option.reverse, option.idx, option.weight || 0.0);
+    }
+}
+
 /**
  * The goal of the schedule evaluator is to efficiently sort the generated schedules
  * according to the set of the rules defined by the user
  */
 class ScheduleEvaluator {
     private _refSchedule!: GeneratedSchedule['All'];
+    /** the section indices of the page of schedules containing the last schedule accessed by getSchedule */
+    private cachedPage: { start: number; sections: Uint16Array } | null = null;
+    /** sections removed before the search because they cannot appear in any schedule */
+    public pruned: PrunedSection[] = [];
+    /**
+     * sectionCounts[i] is the number of valid schedules containing classList[i], so 0 means that it can never be chosen.
+     * The counts are over all valid schedules if their total is known, otherwise only over the schedules generated
+     */
+    public sectionCounts = new Float64Array();
+    /** the number of schedules counted by sectionCounts */
+    public countTotal = 0;
     /**
      * @param options
      * @param events the array of events kept, use to construct generated schedules
@@ -66,9 +183,18 @@ class ScheduleEvaluator {
         refSchedule: GeneratedSchedule['All'] = {},
         private readonly Module?: typeof window.NativeModule
     ) {
+        // the native view is replaced by the schedules of this evaluator
+        if (Module) invalidateNativeView();
         this.refSchedule = refSchedule;
     }
 
+    /**
+     * @returns the fraction of the valid schedules containing the (combined) section classList[idx]
+     */
+    public frequencyOf(idx: number) {
+        return this.countTotal > 0 ? this.sectionCounts[idx] / this.countTotal : 0;
+    }
+
     get size() {
         if (!this.Module) return 0;
         return this.Module._size();
@@ -86,62 +212,124 @@ class ScheduleEvaluator {
 
         const numCourses = this.secLens.length - 1;
         const ptr = this.Module!._malloc(numCourses * 2);
-        const refScheduleEncoded = this.Module.HEAPU16.subarray(ptr / 2, ptr / 2 + numCourses).fill(
-            65535
+        encodeRefSchedule(
+            refSchedule,
+            this.classList,
+            this.secLens,
+            this.Module.HEAPU16.subarray(ptr / 2, ptr / 2 + numCourses)
         );
-        for (const key in refSchedule) {
-            // all section ids of the course with key=key in the reference schedule
-            const refSecs = refSchedule[key].reduce<number[]>((acc, x) => {
-                for (const id of x) acc.push(id);
-                return acc;
-            }, []);
-            for (let i = 0; i < numCourses; i++) {
-                for (let j = this.secLens[i]; j < this.secLens[i + 1]; j++) {
-                    const secs = this.classList[j];
-                    if (secs[0] === key && refSecs.some(id => secs[1].includes(id))) {
-                        refScheduleEncoded[i] = j;
-                        break;
-                    }
-                }
-            }
-        }
         this.Module._setRefSchedule(ptr);
     }
 
-    public sort({ newOptions }: { newOptions?: EvaluatorOptions } = {}) {
+    /**
+     * sort the schedules by the sort options
+     * @param onExact if given, a large view is sorted progressively: the schedules are first ranked
+     * by an approximation from a sample, and the exact sort is then performed in time slices.
+     * onExact is called when the exact order replaces the approximate one. It is not called if the view is sorted at once
+     */
+    public sort({ newOptions, onExact }: { newOptions?: EvaluatorOptions; onExact?: () => void } = {}) {
         if (!this.Module) return;
 
-        console.time('sort');
+        window.clearTimeout(sortTimer);
+        const start = traceStart();
         if (newOptions) this.options = newOptions;
-        this.Module!._setSortMode(this.options.mode);
-
-        // keep the order (!important!)
-        for (let i = 0; i < this.options.sortBy.length; i++) {
-            const option = this.options.sortBy[i];
-            this.Module!._setSortOption(
-                i,
-                +option.enabled,
-                +option.reverse,
-                option.idx,
-                option.weight || 0.0
-            );
+        setNativeSortOptions(this.Module, this.options);
+        this.cachedPage = null;
+        invalidateNativeView();
+        if (onExact && this.size >= PROGRESSIVE_SORT_MIN && this.Module._sortPreview(PREVIEW_SAMPLES) >= 0) {
+            traceEnd('ScheduleEvaluator.sort', start);
+            const step = () => {
+                if (!this.Module!._sortStep(SORT_SLICE)) {
+                    sortTimer = window.setTimeout(step);
+                    return;
+                }
+                this.cachedPage = null;
+                invalidateNativeView();
+                onExact();
+            };
+            sortTimer = window.setTimeout(step);
+            return;
         }
-        this.Module!._sort();
-        console.timeEnd('sort');
+        this.Module._sort();
+        traceEnd('ScheduleEvaluator.sort', start);
     }
 
     /**
-     * Get a `Schedule` object at idx
+     * keep only the schedules matching all of the clauses, without regenerating them.
+     * The remaining schedules are sorted again, and [[size]] becomes the number of them
+     * @param filters the clauses. Pass an empty array to show all schedules again
+     * @returns the number of schedules kept
      */
-    public getSchedule(idx: number) {
+    public filter(filters: ScheduleFilter[]) {
+        if (!this.Module) return 0;
+        const query: number[] = [];
+        for (const { op, sections } of filters) {
+            // map the section ids to the indices of the (combined) sections in the classList
+            const indices = sections.map(id => this.classList.findIndex(secs => secs[1].includes(id)));
+            const found = indices.filter(idx => idx !== -1);
+            // a section that cannot appear in any schedule cannot be included
+            if (op === FilterOp.include && found.length < indices.length) query.push(FilterOp.anyOf, 0);
+            else query.push(op, found.length, ...found);
+        }
+        const ptr = this.Module._malloc(query.length * 4);
+        this.Module.HEAP32.set(query, ptr / 4);
+        // the view is sorted at once again, which cancels the progressive sort in progress
+        window.clearTimeout(sortTimer);
+        const size = this.Module._filterSchedules(ptr, query.length);
+        this.cachedPage = null;
+        invalidateNativeView();
+        return size;
+    }
+
+    /**
+     * export the schedules [start, start + count) in the sorted order in one native call
+     * @param flags bitwise OR of [[ExportFlag]] values
+     */
+    public getPage(start: number, count: number, flags = ExportFlag.sections): SchedulePage {
         const Module = this.Module!;
+        const ptr = Module._exportPage(start, count, flags) / 4;
+        const [num, numCourses] = Module.HEAP32.subarray(ptr, ptr + 4);
+        const numMetrics = Module.HEAP32[ptr + 3];
 
-        const ptr = Module._getSchedule(idx) / 2;
+        const page: SchedulePage = {
+            count: num,
+            sections: Module.HEAPU16.subarray((ptr + 4) * 2, (ptr + 4) * 2 + num * numCourses)
+        };
+        let next = ptr + 4 + Math.ceil((num * numCourses) / 2);
+        if (flags & ExportFlag.metrics) {
+            page.metrics = Module.HEAPF32.subarray(next, next + num * numMetrics);
+            next += num * numMetrics;
+        }
+        if (flags & ExportFlag.blocks) {
+            page.blockOffsets = Module.HEAP32.subarray(next, next + num + 1);
+            next += num + 1;
+            page.blocks = Module.HEAPU16.subarray(next * 2, next * 2 + page.blockOffsets[num]);
+        }
+        return page;
+    }
+
+    /**
+     * Get a `Schedule` object at idx
+     */
+    public getSchedule(idx: number) {
+        const numCourses = this.secLens.length - 1;
+        let page = this.cachedPage;
+        if (!page || idx < page.start || (idx - page.start + 1) * numCourses > page.sections.length) {
+            const start = idx - (idx % PAGE_SIZE);
+            // copy, as the native buffer is reused by the next export
+            page = this.cachedPage = {
+                start,
+                sections: this.getPage(start, PAGE_SIZE).sections.slice()
+            };
+        }
+        const offset = (idx - page.start) * numCourses;
         return new GeneratedSchedule(
-            Array.from(Module.HEAPU16.subarray(ptr, ptr + this.secLens.length - 1)).map(
-                choice => this.classList[choice]
-            ),
-            this.events
+            Array.from(page.sections.subarray(offset, offset + numCourses))
+                .map(choice => this.classList[choice])
+                // the skip sections of the optional courses not taken
+                .filter(secs => secs[1].length > 0),
+            this.events,
+            nativeViewRef(idx)
         );
     }
     /**
@@ -9,14 +9,30 @@
  * This is not a limitation, but rather a design decision, to keep memory usage low. 
 */
 
+// the native test (see the test target in the Makefile) is built without GLPK and the renderer
+#ifndef _TEST
+#include <glpk.h>
+#endif
+
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 #include <limits>
+#include <queue>
 #include <random>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "Arena.hpp"
+#include "MemoryStats.hpp"
+#include "Renderer.hpp"
+#include "Roaring.hpp"
+#include "Solver.hpp"
+#include "Trace.hpp"
+
 using namespace std;
 
 namespace ScheduleGenerator {
@@ -48,6 +64,8 @@ int sortMode = SortMode::combined;
 struct CoeffCache {
     float max, min;
     float* __restrict__ coeffs = NULL;
+    /** length of coeffs */
+    int size;
 };
 
 /** 
@@ -59,16 +77,50 @@ const int* __restrict__ timeMatrix = NULL;
 int tmSize = 0;
 
 int numCourses;
+/** number of schedules in each chunk of the schedule storage (a power of 2) */
+constexpr int CHUNK_SHIFT = 12;
+constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+/**
+ * the generated schedules, stored in fixed-size chunks that are allocated on demand,
+ * so that the memory used grows with the number of schedules actually generated.
+ * Schedule i is stored at scheduleChunks[i / CHUNK_SIZE] + (i % CHUNK_SIZE) * numCourses
+ */
+vector<uint16_t*> scheduleChunks;
+/** the number of courses that each chunk has space for */
+int chunkWidth = 0;
+
+/**
+ * @returns pointer to the schedule at index idx, whose length is numCourses
+ */
+inline uint16_t* scheduleAt(int idx) {
+    return scheduleChunks[idx >> CHUNK_SHIFT] + (idx & (CHUNK_SIZE - 1)) * numCourses;
+}
+
 /**
- * array of schedules. Schedule i is stored at i*numCourse to (i+1)*numCourses
- * @note may not be full
+ * free all chunks but the first numChunks ones
  */
-uint16_t* __restrict__ schedules = NULL;
+void freeScheduleChunks(size_t numChunks) {
+    while (scheduleChunks.size() > numChunks) {
+        free(scheduleChunks.back());
+        scheduleChunks.pop_back();
+        MemoryStats::track(MemoryStats::schedules, -(int64_t)CHUNK_SIZE * chunkWidth * 2);
+    }
+}
+
 /**
- * maximum capcity the schedules
- * @note scheduleLen / numCourses = max number of schedules
- **/
-int scheduleLen = 0;
+ * get the space for the schedule at index idx, allocating a new chunk if needed.
+ * Schedules must be reserved in increasing order of their indices
+ * @returns pointer to the schedule, or NULL on memory allocation failure
+ */
+uint16_t* reserveSchedule(int idx) {
+    if ((size_t)(idx >> CHUNK_SHIFT) == scheduleChunks.size()) {
+        auto* chunk = (uint16_t*)malloc(CHUNK_SIZE * chunkWidth * 2);
+        if (chunk == NULL) return NULL;
+        scheduleChunks.push_back(chunk);
+        MemoryStats::track(MemoryStats::schedules, CHUNK_SIZE * chunkWidth * 2);
+    }
+    return scheduleAt(idx);
+}
 
 /**
  * the reference schedule for sort by similarity. Length=numCourses
@@ -83,18 +135,162 @@ int* __restrict__ indices = NULL;
  */
 float* __restrict__ coeffs = NULL;
 /**
- * the cumulative length of the time arrays for each schedule.
- * offsets[i] is the start index of the time array of schedule `i` in `this.blocks`
+ * the ids of the day patterns of each schedule in the pattern dictionary, stored in the layout given by evalLayout.
+ * Use dayPattern(i, j) to get the pattern of day j of schedule i
+ */
+uint32_t* __restrict__ dayPatterns = NULL;
+
+/**
+ * layouts of dayPatterns
+ */
+enum EvalLayout {
+    /** dayPatterns[i * 7 + j]: the 7 days of each schedule are adjacent. Sort functions are evaluated per schedule */
+    interleavedLayout = 0,
+    /**
+     * dayPatterns[j * count + i]: the same day of all schedules are adjacent.
+     * Sort functions are evaluated for all schedules at once by the batch kernels, one day at a time
+     */
+    splitLayout = 1
+};
+/**
+ * the layout of the current dayPatterns
+ */
+int evalLayout = splitLayout;
+/**
+ * the layout of dayPatterns used by the next generation
+ */
+int nextEvalLayout = splitLayout;
+
+/**
+ * the per-day parts of the sort functions, computed for each pattern
+ */
+enum PatternMetric {
+    /** total class time */
+    classTimeMetric = 0,
+    /** total time in between consecutive classes */
+    gapsMetric,
+    /** overlap of the classes with 11:00 - 14:00, or 0 if the overlap is no more than 60 minutes */
+    lunchMetric,
+    /** square of the minutes between the start of the first class and 12:00, or 0 if the first class starts after 12:00 */
+    earlyMetric,
+    /** walking distance between consecutive classes. Only valid if patternDistanceValid is true */
+    distanceMetric,
+    NUM_PATTERN_METRICS
+};
+/**
+ * the dictionary of the distinct day patterns in the current schedules.
+ * A day pattern is the list of the classes in a day sorted by their start times,
+ * which recurs across a large number of schedules.
+ * The start times, end times and rooms of the classes of pattern p are stored in separate arrays
+ * at [patternBounds[p] ... patternBounds[p + 1])
  */
-int* __restrict__ offsets = NULL;
+vector<uint16_t> patternStarts, patternEnds, patternRooms;
+vector<uint32_t> patternBounds;
 /**
- * array of TimeArrays concatenated together
+ * patternMetrics[m][p] is the metric m of pattern p
  */
-uint16_t* __restrict__ blocks = NULL;
+vector<int> patternMetrics[NUM_PATTERN_METRICS];
+/** whether the distance of each pattern is computed using the current timeMatrix */
+bool patternDistanceValid = false;
 /**
  * number of schedules generated
  */
 int count = 0;
+/**
+ * prunedBy[i] is the index of the course that eliminated section i during the arc-consistency preprocessing,
+ * i.e. section i conflicts with every remaining section of that course. It is -1 if section i is not eliminated.
+ * Length = number of sections
+ */
+int16_t* __restrict__ prunedBy = NULL;
+/**
+ * capacity of prunedBy
+ */
+int prunedLen = 0;
+/**
+ * backing storage for indices, coeffs and dayPatterns
+ */
+void* evalMem = NULL;
+/**
+ * length of the evalMem in bytes
+ */
+uint32_t memSize = 0;
+/**
+ * number of bytes of evalMem used by the current schedules
+ */
+uint32_t evalLen = 0;
+
+/**
+ * @returns the id of the pattern of day j of schedule idx
+ */
+inline uint32_t dayPattern(int idx, int j) {
+    return evalLayout == splitLayout ? dayPatterns[j * count + idx] : dayPatterns[idx * 7 + j];
+}
+
+/**
+ * compute the walking distance between consecutive classes of a day using the current timeMatrix
+ * @param starts, ends, rooms the start times, end times and rooms of the classes, sorted by the start times
+ */
+inline int dayDistance(const uint16_t* __restrict__ starts, const uint16_t* __restrict__ ends, const uint16_t* __restrict__ rooms, uint32_t len) {
+    // timeMatrix is actually a flattened matrix, so matrix[i][j] = matrix[i*len+j]
+    int dist = 0;
+    for (uint32_t j = 1; j < len; j++) {
+        // does not count the distance of the gap between two classes is greater than 45 minutes
+        if (starts[j] - ends[j - 1] < 45) {
+            auto r1 = rooms[j - 1],
+                 r2 = rooms[j];
+
+            // skip unknown buildings
+            if (r1 != (uint16_t)65535 && r2 != (uint16_t)65535) dist += timeMatrix[r1 * tmSize + r2];
+        }
+    }
+    return dist;
+}
+
+/**
+ * compute the metrics of a day other than the distance
+ * @param starts, ends the start and end times of the classes, sorted by the start times
+ * @param metrics output, indexed by PatternMetric
+ */
+inline void dayMetrics(const uint16_t* __restrict__ starts, const uint16_t* __restrict__ ends, uint32_t len, int* __restrict__ metrics) {
+    int classTime = 0, gaps = 0, lunch = 0, early = 0;
+    for (uint32_t k = 0; k < len; k++) {
+        classTime += ends[k] - starts[k];
+        // 11:00 to 14:00
+        lunch += calcOverlap((int16_t)660, (int16_t)840, (int16_t)starts[k], (int16_t)ends[k]);
+    }
+    for (uint32_t k = 1; k < len; k++) gaps += starts[k] - ends[k - 1];
+    if (len > 0) {
+        int temp = std::max(12 * 60 - starts[0], 0);
+        early = temp * temp;
+    }
+    metrics[classTimeMetric] = classTime;
+    metrics[gapsMetric] = gaps;
+    metrics[lunchMetric] = lunch > 60 ? lunch : 0;
+    metrics[earlyMetric] = early;
+}
+
+/**
+ * compute the walking distance of each day pattern using the current timeMatrix
+ */
+void computePatternDistances() {
+    auto& distances = patternMetrics[distanceMetric];
+    for (size_t p = 0; p < distances.size(); p++) {
+        uint32_t begin = patternBounds[p];
+        distances[p] = dayDistance(patternStarts.data() + begin, patternEnds.data() + begin, patternRooms.data() + begin,
+                                   patternBounds[p + 1] - begin);
+    }
+    patternDistanceValid = true;
+}
+
+/**
+ * sum the metric of the patterns of the 7 days of schedule idx
+ */
+inline int sumMetric(int idx, PatternMetric m) {
+    const auto* __restrict__ metric = patternMetrics[m].data();
+    int sum = 0;
+    for (int i = 0; i < 7; i++) sum += metric[dayPattern(idx, i)];
+    return sum;
+}
 
 /**
  * compute the variance of class times during the week
@@ -102,14 +298,11 @@ int count = 0;
  * returns a higher value when the class times are unbalanced
  */
 float variance(int idx) {
-    const auto* _blocks = blocks + offsets[idx];
+    const auto* __restrict__ classTimes = patternMetrics[classTimeMetric].data();
     int sum = 0,
         sumSq = 0;
     for (int i = 0; i < 7; i++) {
-        int classTime = 0;
-        for (int j = _blocks[i], end = _blocks[i + 1]; j < end; j += 3) {
-            classTime += _blocks[j + 1] - _blocks[j];
-        }
+        int classTime = classTimes[dayPattern(idx, i)];
         sum += classTime;
         sumSq += classTime * classTime;
     }
@@ -124,14 +317,7 @@ float variance(int idx) {
  * The greater the time gap between classes, the greater the return value will be
  */
 float compactness(int idx) {
-    const auto* _blocks = blocks + offsets[idx];
-    int compact = 0;
-    for (int i = 0; i < 7; i++) {
-        for (int j = _blocks[i], end = _blocks[i + 1] - 5; j < end; j += 3) {
-            compact += _blocks[j + 3] - _blocks[j + 1];
-        }
-    }
-    return compact;
+    return sumMetric(idx, gapsMetric);
 };
 
 /**
@@ -141,19 +327,7 @@ float compactness(int idx) {
  * The greater the overlap, the greater the return value will be
  */
 float lunchTime(int idx) {
-    const auto* _blocks = blocks + offsets[idx];
-    // 11:00 to 14:00
-    int totalOverlap = 0;
-    for (int i = 0; i < 7; i++) {
-        int dayOverlap = 0;
-        for (int j = _blocks[i], end = _blocks[i + 1]; j < end; j += 3) {
-            // 11:00 to 14:00
-            dayOverlap += calcOverlap((int16_t)660, (int16_t)840, (int16_t)_blocks[j], (int16_t)_blocks[j + 1]);
-        }
-
-        if (dayOverlap > 60) totalOverlap += dayOverlap;
-    }
-    return totalOverlap;
+    return sumMetric(idx, lunchMetric);
 };
 
 /**
@@ -162,47 +336,65 @@ float lunchTime(int idx) {
  * For a schedule that has earlier classes, this method will return a higher number
  */
 float noEarly(int idx) {
-    const auto* _blocks = blocks + offsets[idx];
-    int refTime = 12 * 60;
-    int total = 0;
-    for (int i = 0; i < 7; i++) {
-        int start = _blocks[i],
-            end = _blocks[i + 1];
-        if (end > start) {
-            // if this day is not empty
-            int time = _blocks[start];
-            int temp = max(refTime - time, 0);
-            total += temp * temp;
-        }
-    }
-    return total;
+    return sumMetric(idx, earlyMetric);
 }
 
 /**
  * compute the sum of walking distances between each consecutive pair of classes
  */
 float distance(int idx) {
-    const auto* _blocks = blocks + offsets[idx];
-    // timeMatrix is actually a flattened matrix, so matrix[i][j] = matrix[i*len+j]
-    int dist = 0;
-    for (int i = 0; i < 7; i++) {
-        for (int j = _blocks[i], end = _blocks[i + 1] - 5; j < end; j += 3) {
-            // does not count the distance of the gap between two classes is greater than 45 minutes
-            if (_blocks[j + 3] - _blocks[j + 1] < 45) {
-                auto r1 = _blocks[j + 2],
-                     r2 = _blocks[j + 5];
+    if (!patternDistanceValid) computePatternDistances();
+    return sumMetric(idx, distanceMetric);
+}
 
-                // skip unknown buildings
-                if (r1 != (uint16_t)65535 && r2 != (uint16_t)65535) dist += timeMatrix[r1 * tmSize + r2];
+/**
+ * compute the sort function funcIdx for the schedules [from, to) at once, reading the patterns one day at a time
+ * so that the loops over the schedules access dayPatterns and out contiguously
+ * @param out the coefficient of each schedule, indexed by the schedule. Only out[from, to) is written
+ * @returns false if the sort function has no batch kernel or the layout is not splitLayout
+ */
+bool evalBatch(int funcIdx, float* __restrict__ out, int from, int to) {
+    if (evalLayout != splitLayout) return false;
+    const int metricOf[] = {distanceMetric, classTimeMetric, gapsMetric, lunchMetric, earlyMetric};
+    if (funcIdx < 0 || funcIdx >= (int)(sizeof(metricOf) / sizeof(int))) return false;
+    if (funcIdx == 0 && !patternDistanceValid) computePatternDistances();
+
+    const auto* __restrict__ metric = patternMetrics[metricOf[funcIdx]].data();
+    // process the schedules in tiles so that the partial sums stay in the cache across the 7 days
+    constexpr int TILE = 1024;
+    int sum[TILE], sumSq[TILE];
+    for (int lo = from; lo < to; lo += TILE) {
+        int n = std::min(TILE, to - lo);
+        memset(sum, 0, n * sizeof(int));
+        if (funcIdx == 1) {
+            // variance needs both the sum and the sum of squares
+            memset(sumSq, 0, n * sizeof(int));
+            for (int j = 0; j < 7; j++) {
+                const auto* __restrict__ day = dayPatterns + j * count + lo;
+                for (int i = 0; i < n; i++) {
+                    int classTime = metric[day[i]];
+                    sum[i] += classTime;
+                    sumSq[i] += classTime * classTime;
+                }
             }
+            for (int i = 0; i < n; i++) {
+                float mean = sum[i] / 5.0f;
+                out[lo + i] = sumSq[i] / 5.0f - mean * mean;
+            }
+        } else {
+            for (int j = 0; j < 7; j++) {
+                const auto* __restrict__ day = dayPatterns + j * count + lo;
+                for (int i = 0; i < n; i++) sum[i] += metric[day[i]];
+            }
+            for (int i = 0; i < n; i++) out[lo + i] = sum[i];
         }
     }
-    return dist;
+    return true;
 }
 
 float similarity(int idx) {
     int sum = numCourses;
-    const auto* curSchedule = schedules + idx * numCourses;
+    const auto* curSchedule = scheduleAt(idx);
     for (int j = 0; j < numCourses; j++)
         sum -= (refSchedule[j] == curSchedule[j]);
     return sum;
@@ -243,339 +435,2147 @@ SortOption sortOptions[NUM_SORT_FUNCS];
 CoeffCache sortCoeffCache[NUM_SORT_FUNCS];
 
 /**
- * whether the random sort option is enabled
+ * an exact sort performed in time slices after sortPreview, so that the approximate ranking can be shown meanwhile.
+ * The coefficient caches of the enabled functions are filled in chunks of schedules,
+ * then the coefficients are combined in chunks, and finally the view is ordered in one go
  */
-bool isRandom() {
-    for (auto& opt : sortOptions) {
-        if (opt.idx == 6 && opt.enabled) return true;
+struct SortJob {
+    enum Phase { idle, evaluate, combine, order };
+    /** number of schedules processed between two checks of the deadline */
+    static constexpr int CHUNK = 1 << 16;
+
+    Phase phase = idle;
+    SortOption options[NUM_SORT_FUNCS];
+    int enabled = 0;
+    /** the enabled option being evaluated */
+    int option = 0;
+    /** the next schedule to evaluate or combine */
+    int next = 0;
+    /** the coefficients of the option being evaluated, moved to sortCoeffCache when all schedules are evaluated */
+    float* pending = NULL;
+    float max, min;
+    /** length of pending */
+    int size = 0;
+
+    /**
+     * start a sort with the current sort options
+     * @returns the number of enabled options, or 0 if the view is already sorted, i.e. shuffled by the random option
+     * or kept in its original order if no option is enabled
+     */
+    int start();
+    /**
+     * continue the sort until it is complete or the budget is used up
+     * @param budget the time budget in milliseconds. No limit if it is not positive
+     * @returns true if the sort is complete
+     */
+    bool step(double budget);
+
+    void cancel() {
+        if (pending != NULL) {
+            delete[] pending;
+            pending = NULL;
+            MemoryStats::track(MemoryStats::sortCoeffCache, -(int64_t)size * sizeof(float));
+        }
+        phase = idle;
     }
-    return false;
-}
+} sortJob;
 
 /**
- * compute the coefficient array for a specific sorting option.
- * if it exists (i.e. already computed), don't do anything
- * @param funcIdx the index of the sorting option
- * @param assign whether assign to the values to `coeffs`
- * @returns the computed/cached coefficients
+ * free the coefficient cache of the sort function at funcIdx, if it exists.
+ * A time-sliced sort in progress is cancelled, as it may depend on the cache
  */
-CoeffCache computeCoeffFor(int funcIdx, bool assign) {
+void freeCoeffCache(int funcIdx) {
+    sortJob.cancel();
     auto& cache = sortCoeffCache[funcIdx];
     if (cache.coeffs != NULL) {
-        if (assign) memcpy(coeffs, cache.coeffs, count * sizeof(float));
-        return cache;
-    } else {
-        auto* __restrict__ newCache = new float[count];
-        float max = -std::numeric_limits<float>::infinity(),
-              min = std::numeric_limits<float>::infinity();
-        auto evalFunc = sortFunctions[funcIdx];
-        for (int i = 0; i < count; i++) {
-            float val = (newCache[i] = evalFunc(i));
-            if (val > max) max = val;
-            if (val < min) min = val;
-        }
-        if (assign) memcpy(coeffs, newCache, count * sizeof(float));
-        return (sortCoeffCache[funcIdx] = {max, min, newCache});
+        delete[] cache.coeffs;
+        cache.coeffs = NULL;
+        MemoryStats::track(MemoryStats::sortCoeffCache, -(int64_t)cache.size * sizeof(float));
     }
 }
 
 /**
- * pre-compute the coefficient for each schedule using each enabled sorting function
- * so that they don't need to be computed on the fly when sorting
+ * point indices, coeffs and dayPatterns to their respective parts of evalMem
  */
-void computeCoeff(int enabled, int lastIdx) {
-    // if there's only one option enabled, just compute coefficients for it and
-    // assign to the .coeff field for each schedule
-    if (enabled == 1) {
-        computeCoeffFor(lastIdx, true);
-        return;
-    }
+inline void assignEvalMem() {
+    indices = (int*)evalMem;
+    coeffs = ((float*)evalMem) + count;
+    dayPatterns = ((uint32_t*)evalMem) + 2 * count;
+}
 
-    if (sortMode == SortMode::fallback) {
-        for (auto option : sortOptions) {
-            if (option.enabled)
-                computeCoeffFor(option.idx, false);
-        }
-    } else {
-        memset(coeffs, 0, count * sizeof(float));
-        for (auto& option : sortOptions) {
-            if (!option.enabled) continue;
+/**
+ * sectionIndex[i] is the set of the schedules (in the order of generation) that contain section i.
+ * Built by the first filterSchedules after each generation
+ */
+vector<Roaring::Bitmap> sectionIndex;
+bool sectionIndexValid = false;
+/**
+ * number of schedules in the view, which are the schedules matching the last filterSchedules,
+ * or all schedules if they are not filtered. sort, size, getSchedule and exportPage only see the view
+ */
+int viewCount = 0;
+/**
+ * the schedules in the view in ascending order. Empty if the schedules are not filtered
+ */
+vector<int> viewSchedules;
 
-            const auto& cache = computeCoeffFor(option.idx, false);
+/**
+ * the operators of the clauses of filterSchedules
+ */
+enum FilterOp {
+    /** the schedule contains all of the sections */
+    includeAll = 0,
+    /** the schedule contains none of the sections */
+    excludeAny = 1,
+    /** the schedule contains at least one of the sections */
+    includeAny = 2
+};
 
-            float max = cache.max, min = cache.min;
-            float range = max - min;
-            // if all of the values are the same, skip this sorting coefficient
-            if (range == 0.0) {
-                continue;
-            }
+/**
+ * remove the filter, so that the view contains all schedules
+ */
+void resetView() {
+    viewCount = count;
+    viewSchedules.clear();
+}
 
-            float normalizeRatio = 1 / range,
-                  weight = option.weight;
-            auto coeff = cache.coeffs;
-            // use Euclidean distance to combine multiple sorting coefficients
-            if (option.reverse) {
-                for (int i = 0; i < count; i++) {
-                    float val = (max - coeff[i]) * normalizeRatio;
-                    coeffs[i] += weight * val * val;
-                }
-            } else {
-                for (int i = 0; i < count; i++) {
-                    float val = (coeff[i] - min) * normalizeRatio;
-                    coeffs[i] += weight * val * val;
-                }
-            }
+/**
+ * report the memory held by the section index and the view
+ */
+void trackIndexMemory() {
+    size_t bytes = sectionIndex.capacity() * sizeof(Roaring::Bitmap) + viewSchedules.capacity() * sizeof(int);
+    for (auto& bitmap : sectionIndex) bytes += bitmap.bytes();
+    MemoryStats::set(MemoryStats::sectionIndex, bytes);
+}
+
+/**
+ * build the section index of the current schedules
+ */
+void buildSectionIndex() {
+    TRACE_SPAN("ScheduleGenerator::buildSectionIndex");
+    sectionIndex.clear();
+    for (int i = 0; i < count; i++) {
+        const auto* schedule = scheduleAt(i);
+        for (int j = 0; j < numCourses; j++) {
+            if (schedule[j] >= sectionIndex.size()) sectionIndex.resize(schedule[j] + 1);
+            sectionIndex[schedule[j]].append(i);
         }
     }
+    sectionIndexValid = true;
+    trackIndexMemory();
 }
 
-extern "C" {
-
 /**
- * initialize the global indices, offsets and blocks array so the sort function can use then
-*/
-void addToEval(const uint16_t* __restrict__ timeArray, const int* __restrict__ sectionLens) {
-    int offset = 0;
-    // point to the second part of the timeArray where the content is stored
-    // should not alias with timeArray, which should be only used to access the first part
-    const auto* __restrict__ timeArrayContent = timeArray + (sectionLens[numCourses]) * 8;
-    const auto* __restrict__ curSchedule = schedules;
-    // store the time and room information corresponding to curSchedule
-    auto* __restrict__ curBlock = blocks;
-    for (int i = 0; i < count; i++) {  // for each schedule
-        int bound = 8;
-        for (int j = 0; j < 7; j++) {  // sort the time blocks in order for each day
-            // start index of day j in curBlock
-            int s1 = (curBlock[j] = bound);
+ * report the memory held by the pattern dictionary
+ */
+void trackPatternMemory() {
+    size_t bytes = (patternStarts.capacity() + patternEnds.capacity() + patternRooms.capacity()) * sizeof(uint16_t) +
+                   patternBounds.capacity() * sizeof(uint32_t);
+    for (auto& metric : patternMetrics) bytes += metric.capacity() * sizeof(int);
+    MemoryStats::set(MemoryStats::dayPatterns, bytes);
+}
 
-            // for each section selected (for each course), extract its time blocks on day j,
-            // and insert into day j of curBlock
-            for (int k = 0; k < numCourses; k++) {
-                // offset of the time arrays
-                int _off = curSchedule[k] * 8 + j;
-                // insertion sort, fast for small arrays
-                for (int n = timeArray[_off], e2 = timeArray[_off + 1]; n < e2; n += 3, bound += 3) {
-                    int p = s1;
-                    uint16_t vToBeInserted = timeArrayContent[n];
-                    for (; p < bound; p += 3) {
-                        if (vToBeInserted < curBlock[p]) break;
-                    }
-                    // move elements 3 slots toward the end
-                    for (int m = bound - 1; m >= p; m--) curBlock[m + 3] = curBlock[m];
-                    // insert three elements at p
-                    curBlock[p] = timeArrayContent[n];
-                    curBlock[p + 1] = timeArrayContent[n + 1];
-                    curBlock[p + 2] = timeArrayContent[n + 2];
-                    // TODO: bulk move
-                    // *((TimeEntry*)&timeArrayContent[n]) = *((TimeEntry*)&curBlock[p]);
-                }
+void releaseMemory(int flags) {
+    if (flags & MemoryStats::releaseSortCache) {
+        for (int i = 0; i < NUM_SORT_FUNCS; i++) freeCoeffCache(i);
+    }
+    if (flags & MemoryStats::shrinkSchedules) {
+        freeScheduleChunks((count + CHUNK_SIZE - 1) >> CHUNK_SHIFT);
+        if (evalLen > 0 && evalLen < memSize) {
+            void* newMem = realloc(evalMem, evalLen);
+            if (newMem != NULL) {
+                evalMem = newMem;
+                memSize = evalLen;
+                assignEvalMem();
+                MemoryStats::set(MemoryStats::evalMem, memSize);
             }
         }
-        // record the current offset
-        offsets[i] = offset;
-        offset += curBlock[7] = bound;
-        // goto the next schedule
-        curBlock += bound;
-        curSchedule += numCourses;
+        patternStarts.shrink_to_fit();
+        patternEnds.shrink_to_fit();
+        patternRooms.shrink_to_fit();
+        patternBounds.shrink_to_fit();
+        for (auto& metric : patternMetrics) metric.shrink_to_fit();
+        trackPatternMemory();
+    }
+    if (flags & MemoryStats::releaseSectionIndex) {
+        sectionIndex.clear();
+        sectionIndex.shrink_to_fit();
+        sectionIndexValid = false;
+        trackIndexMemory();
     }
 }
+
 /**
- * @param _numCourses number of courses
- * @param sectionLens a prefix array that stores the number of sections in each course
- * sectionLens[i] is the total number of sections in courses 0 to i - 1 inclusive
- * sectionLens[numCourses] is the total number of sections 
- * @param conflictCache the conflict cache matrix which caches the conflict between each pair of sections.
- * To check whether section i conflicts with section j: conflictCache[i * numSections + j] (or conflictCache[j * numSections + i])
- * Can do bitpacking, but no performance improvement observed
- * @param timeArray TODO: add description.
- * @note the pointers passed in to this function should point to dynamically allocated memory. They will be freed before this function returns. 
- * @returns the number of schedules generated. Returns -1 on memory allocation failure
+ * whether the random sort option is enabled
  */
-int generate(const int _numCourses, int maxNumSchedules, const int* __restrict__ sectionLens, const uint8_t* __restrict__ conflictCache, const uint16_t* __restrict__ timeArray) {
-    numCourses = _numCourses;
-    maxNumSchedules *= numCourses;
-    if (maxNumSchedules + numCourses > scheduleLen) {
-        // extra 1x numCourses to prevent write out of bound at computeSchedules at *!*!*
-        scheduleLen = maxNumSchedules + numCourses;
-        auto* newMem = (uint16_t*)realloc(schedules, scheduleLen * 2);
-        // handle allocation failure
-        if (newMem == NULL) return -1;
-        schedules = newMem;
-    }
-
-    /** the total length of the time array that we need to allocate for schedules generated */
-    int timeLen = 0;
-    /** current course index */
-    int courseIdx = 0;
-    /** the index of the current section */
-    int sectionIdx = 0;
-    /** pointer to the current schedule */
-    auto* curSchedule = schedules;
-    int numSections = sectionLens[numCourses];
-    while (true) {
-        if (courseIdx >= numCourses) {  // we have finished building the current schedule
-            // accumulate the length of the time arrays combined in each schedule
-            // and copy the current schedule to next schedule
-            auto* nextSchedule = curSchedule + numCourses;
-            for (int i = 0; i < numCourses; i++) {
-                int secIdx = (nextSchedule[i] = curSchedule[i]);  // *!*!*
-                int _off = secIdx * 8;
-                timeLen += timeArray[_off + 7] - timeArray[_off];
-            }
+bool isRandom() {
+    for (auto& opt : sortOptions) {
+        if (opt.idx == 6 && opt.enabled) return true;
+    }
+    return false;
+}
 
-            curSchedule = nextSchedule;
-            if (curSchedule - schedules >= maxNumSchedules) goto end;
-            sectionIdx = curSchedule[--courseIdx] + 1;
-        }
-    next:;
-        /**
-         * when all possibilities in on class have exhausted, explore the next possibility in the previous class
-         * reset choices of the later classes to 0
-         */
-        while (sectionIdx >= sectionLens[courseIdx + 1]) {
-            // return to the previous class
-            // if all possibilities are exhausted, break out the loop
-            if (--courseIdx < 0) goto end;
+/**
+ * combine the cached coefficients of the enabled sorting functions into `coeffs` for the schedules [from, to).
+ * The caches of the enabled functions must exist
+ */
+void combineCoeff(const SortOption* enabledOptions, int enabled, int from, int to) {
+    // if there's only one option enabled, just assign its coefficients to the .coeff field for each schedule
+    if (enabled == 1) {
+        memcpy(coeffs + from, sortCoeffCache[enabledOptions[0].idx].coeffs + from, (to - from) * sizeof(float));
+        return;
+    }
+    // the fallback comparator reads the caches directly
+    if (sortMode == SortMode::fallback) return;
 
-            // explore the next possibility
-            sectionIdx = curSchedule[courseIdx] + 1;
-            for (int i = courseIdx + 1; i < numCourses; i++) curSchedule[i] = 0;
+    memset(coeffs + from, 0, (to - from) * sizeof(float));
+    for (int k = 0; k < enabled; k++) {
+        const auto& option = enabledOptions[k];
+        const auto& cache = sortCoeffCache[option.idx];
+
+        float max = cache.max, min = cache.min;
+        float range = max - min;
+        // if all of the values are the same, skip this sorting coefficient
+        if (range == 0.0) {
+            continue;
         }
 
-        // check conflict between the newly chosen section and the sections already in the schedule
-        int temp = sectionIdx * numSections;
-        for (int i = 0; i < courseIdx; i++) {
-            if (conflictCache[temp + curSchedule[i]]) {
-                // if conflict, increment the section index
-                ++sectionIdx;
-                goto next;
+        float normalizeRatio = 1 / range,
+              weight = option.weight;
+        auto coeff = cache.coeffs;
+        // use Euclidean distance to combine multiple sorting coefficients
+        if (option.reverse) {
+            for (int i = from; i < to; i++) {
+                float val = (max - coeff[i]) * normalizeRatio;
+                coeffs[i] += weight * val * val;
+            }
+        } else {
+            for (int i = from; i < to; i++) {
+                float val = (coeff[i] - min) * normalizeRatio;
+                coeffs[i] += weight * val * val;
             }
         }
+    }
+}
 
-        // if the section does not conflict with any previously chosen sections,
-        // record the section and go to the next class,
-        curSchedule[courseIdx++] = sectionIdx;
-        // set choice num to be the first section of the next class
-        sectionIdx = sectionLens[courseIdx];
+/**
+ * reset the schedules in the view to their original order,
+ * so that when the sort is performed repetitively, the result will be stable
+ */
+void resetIndices() {
+    if (viewSchedules.empty()) {
+        for (int i = 0; i < viewCount; i++)
+            indices[i] = i;
+    } else {
+        memcpy(indices, viewSchedules.data(), viewCount * sizeof(int));
     }
-end:;
-    count = (curSchedule - schedules) / numCourses;
-    timeLen += 8 * count;
+}
 
-    /**
-     * backing storage for indices, coeffs, offsets and blocks
-     */
-    static void* evalMem = NULL;
-    /**
-     * length of the evalMem in bytes
-     */
-    static uint32_t memSize = 0;
+/**
+ * the comparator of the fallback sort mode: compare by the first enabled option,
+ * and fallback to the next option if the coefficients are equal
+ */
+struct FallbackCompare {
+    int enabled;
+    /** if option[i] is reverse, rev[i] will be -1 */
+    float rev[NUM_SORT_FUNCS];
+    /** cached array of coefficients for each enabled sort function */
+    const float* coeffs[NUM_SORT_FUNCS];
 
-    // handle reallocation of memory
-    uint32_t newMemSize = (uint32_t)(count)*3 * 4 + (uint32_t)(timeLen)*2;
-    if (newMemSize > memSize) {
-        void* newMem = realloc(evalMem, newMemSize);
-        if (newMem == NULL) return -1;
-        evalMem = newMem;
-        memSize = newMemSize;
-        indices = (int*)evalMem;
-        coeffs = ((float*)evalMem) + count;
-        offsets = ((int*)evalMem) + 2 * count;
-        blocks = ((uint16_t*)evalMem) + 6 * count;
-    }
+    bool operator()(int a, int b) const {
+        float r = 0;
+        for (int i = 0; i < enabled; i++) {
+            // calculate the difference in coefficients
+            r = rev[i] * (coeffs[i][a] - coeffs[i][b]);
 
-    addToEval(timeArray, sectionLens);
+            // if non-zero, returns this coefficient
+            if (r != 0.0) return r < 0;
 
-// cleanup
-#ifndef _TEST
-    free((void*)sectionLens);
-    free((void*)conflictCache);
-    free((void*)timeArray);
-#endif
-    for (auto& cache : sortCoeffCache) {
-        if (cache.coeffs != NULL) {
-            delete[] cache.coeffs;
-            cache.coeffs = NULL;
+            // otherwise, fallback to the next sort option
         }
+        return r < 0;
     }
-    return count;
-}
+};
+
+/**
+ * sort the view by cmpFunc. Only the first 1000 schedules are sorted if there are more
+ */
+template <typename F>
+void sortView(F cmpFunc) {
+    if (viewCount > 1000) {
+        std::partial_sort(indices, indices + 1000, indices + viewCount, cmpFunc);
+    } else {
+        std::sort(indices, indices + viewCount, cmpFunc);
+    }
+}
+
+/**
+ * sort the view by the coefficients of the enabled options, which are combined by `combineCoeff`
+ */
+void orderView(const SortOption* enabledOptions, int enabled) {
+    if (sortMode == SortMode::combined || enabled == 1) {
+        /**
+         * The comparator function used:
+         *
+         * if only one option is enabled, the sort direction depends on the `reversed` property of it
+         *
+         * if multiple sort options are enabled and the sort mode is combined, the `combineCoeff` method
+         * will take care of the sort direction of each function, so we sort in ascending order anyway
+         */
+        if (enabledOptions[0].reverse && enabled == 1)
+            sortView([](int a, int b) { return coeffs[b] < coeffs[a]; });  // descending
+        else
+            sortView([](int a, int b) { return coeffs[a] < coeffs[b]; });  // ascending
+    } else {
+        FallbackCompare cmpFunc;
+        cmpFunc.enabled = enabled;
+        for (int i = 0; i < enabled; i++) {
+            cmpFunc.rev[i] = enabledOptions[i].reverse ? -1.0f : 1.0f;
+            cmpFunc.coeffs[i] = sortCoeffCache[enabledOptions[i].idx].coeffs;
+        }
+        sortView(cmpFunc);
+    }
+}
+
+int SortJob::start() {
+    cancel();
+    enabled = 0;
+    for (int i = 0; i < 7; i++) {
+        auto& opt = sortOptions[i];
+        if (opt.enabled) options[enabled++] = opt;
+    }
+    if (isRandom() || enabled == 0) {
+        resetIndices();
+        if (isRandom()) {
+            default_random_engine eng;
+            shuffle(indices, indices + viewCount, eng);
+        }
+        return 0;
+    }
+    option = next = 0;
+    phase = evaluate;
+    return enabled;
+}
+
+bool SortJob::step(double budget) {
+    auto deadline = chrono::steady_clock::now() + chrono::duration<double, milli>(budget);
+    auto expired = [&]() { return budget > 0 && chrono::steady_clock::now() >= deadline; };
+
+    while (phase == evaluate) {
+        if (option == enabled) {
+            phase = combine;
+            next = 0;
+            break;
+        }
+        int idx = options[option].idx;
+        if (sortCoeffCache[idx].coeffs != NULL) {
+            option++;
+            continue;
+        }
+        if (pending == NULL) {
+            pending = new float[count];
+            size = count;
+            next = 0;
+            max = -std::numeric_limits<float>::infinity();
+            min = std::numeric_limits<float>::infinity();
+            MemoryStats::track(MemoryStats::sortCoeffCache, count * sizeof(float));
+        }
+        int to = std::min(next + CHUNK, count);
+        if (!evalBatch(idx, pending, next, to)) {
+            auto evalFunc = sortFunctions[idx];
+            for (int i = next; i < to; i++) pending[i] = evalFunc(i);
+        }
+        for (int i = next; i < to; i++) {
+            float val = pending[i];
+            if (val > max) max = val;
+            if (val < min) min = val;
+        }
+        next = to;
+        if (next == count) {
+            sortCoeffCache[idx] = {max, min, pending, count};
+            pending = NULL;
+            option++;
+        }
+        if (expired()) return false;
+    }
+    while (phase == combine) {
+        int to = std::min(next + CHUNK, count);
+        combineCoeff(options, enabled, next, to);
+        next = to;
+        if (next == count)
+            phase = order;
+        else if (expired())
+            return false;
+    }
+    if (phase == order) {
+        // we start from the original order rather than the preview
+        resetIndices();
+        orderView(options, enabled);
+        phase = idle;
+    }
+    return true;
+}
+
+/** granularity of the occupancy bitmaps in minutes */
+constexpr int SLOT_SIZE = 5;
+constexpr int SLOTS_PER_DAY = 24 * 60 / SLOT_SIZE;
+/** number of 64-bit words of an occupancy bitmap of a week */
+constexpr int OCC_WORDS = (7 * SLOTS_PER_DAY + 63) / 64;
+
+/**
+ * the weekly occupancy bitmap of a section or a partial schedule.
+ * Bit (day * SLOTS_PER_DAY + slot) is set if the time slot [slot * SLOT_SIZE, (slot + 1) * SLOT_SIZE) of the day is occupied
+ */
+struct Occupancy {
+    uint64_t bits[OCC_WORDS];
+    /** only words [lo, hi) can be non-zero */
+    uint8_t lo, hi;
+    /**
+     * whether an overlap of the bitmaps implies a time conflict, i.e. all meetings are aligned to the slots,
+     * and the date range of the section overlaps with the date ranges of all other sections
+     */
+    bool exact;
+};
+
+/**
+ * build the occupancy bitmap of a time array
+ * @param header the 8 offsets of the days, relative to content
+ * @param step 3 for (start, end, room) triples, 2 for (start, end) pairs
+ * @note occ.exact is set to whether all meetings are aligned to the slots
+ */
+void buildOccupancy(Occupancy& occ, const uint16_t* __restrict__ header, const uint16_t* __restrict__ content, int step) {
+    memset(occ.bits, 0, sizeof(occ.bits));
+    occ.lo = OCC_WORDS;
+    occ.hi = 0;
+    occ.exact = true;
+    for (int day = 0; day < 7; day++) {
+        for (int j = header[day], end = header[day + 1]; j < end; j += step) {
+            int start = content[j], finish = content[j + 1];
+            if (start % SLOT_SIZE || finish % SLOT_SIZE || finish > 24 * 60) occ.exact = false;
+            int first = day * SLOTS_PER_DAY + start / SLOT_SIZE,
+                last = day * SLOTS_PER_DAY + std::min((finish + SLOT_SIZE - 1) / SLOT_SIZE, SLOTS_PER_DAY);
+            for (int b = first; b < last; b++) occ.bits[b >> 6] |= (uint64_t)1 << (b & 63);
+            if (first < last) {
+                occ.lo = std::min(occ.lo, (uint8_t)(first >> 6));
+                occ.hi = std::max(occ.hi, (uint8_t)(((last - 1) >> 6) + 1));
+            }
+        }
+    }
+    if (occ.lo > occ.hi) occ.lo = occ.hi;
+}
+
+/**
+ * whether any meetings of two time arrays of (start, end, room) triples overlap
+ * @param a the 8 offsets of the days of the first time array, relative to contentA
+ * @param b the 8 offsets of the days of the second time array, relative to contentB
+ */
+bool timesOverlap(const uint16_t* __restrict__ a, const uint16_t* __restrict__ contentA, const uint16_t* __restrict__ b,
+                  const uint16_t* __restrict__ contentB) {
+    for (int day = 0; day < 7; day++) {
+        int e1 = a[day + 1], s2 = b[day], e2 = b[day + 1];
+        for (int j = a[day]; j < e1; j += 3) {
+            for (int k = s2; k < e2; k += 3) {
+                if (calcOverlap<int>(contentA[j], contentA[j + 1], contentB[k], contentB[k + 1]) > 0) return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * the catalog-wide table of sections, keyed by catalog section id. It is built once per catalog by buildCatalogIndex
+ * and serialized to a compact binary file by exportCatalogIndex, which can be loaded back by loadCatalogIndex.
+ *
+ * It keeps the meetings, rooms and date range of each section in the layout of generate, so the inputs of a generation
+ * are gathered from the table by gatherSections instead of being converted from the catalog objects.
+ * The sections meeting at exactly the same times share a time pattern. The table keeps the occupancy bitmap of each pattern
+ * and the exact conflict bitset of each pattern against all patterns, so the conflicts between the sections of a generation
+ * are looked up instead of being recomputed from their time arrays
+ */
+struct CatalogIndex {
+    /** 'CIDX' */
+    static constexpr uint32_t MAGIC = 0x58444943;
+    static constexpr uint32_t VERSION = 2;
+    /** number of uint32 words of the header of the binary file */
+    static constexpr int HEADER_WORDS = 8;
+
+    /** the catalog section ids in ascending order. The other per-section arrays are in the same order */
+    vector<int> ids;
+    /** the time pattern of each section */
+    vector<uint32_t> patternOf;
+    /** [start, end] date of each section in days */
+    vector<int> dates;
+    /** the rooms of section i are rooms[roomOffsets[i] ... roomOffsets[i + 1]), in the order of the meetings of its pattern */
+    vector<uint32_t> roomOffsets;
+    vector<uint16_t> rooms;
+    /**
+     * the time array of pattern p is patternTimes[patternOffsets[p] ... patternOffsets[p + 1]):
+     * 8 offsets of the days relative to the end of the offsets, followed by (start, end, 0) triples
+     */
+    vector<uint32_t> patternOffsets;
+    vector<uint16_t> patternTimes;
+    /** the occupancy bitmap of each pattern. The exact flag only reflects the alignment of the meetings to the slots */
+    vector<Occupancy> patterns;
+    /** number of uint64 words of a row of conflicts */
+    int rowWords = 0;
+    /** bit q of row p is set if patterns p and q meet at overlapping times */
+    vector<uint64_t> conflicts;
+
+    /**
+     * @returns the index of the section with the given catalog id, or -1 if it is not in the table
+     */
+    int indexOf(int id) const {
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        return it == ids.end() || *it != id ? -1 : it - ids.begin();
+    }
+
+    inline const uint16_t* patternTimeArray(int p) const {
+        return patternTimes.data() + patternOffsets[p];
+    }
+
+    inline bool conflict(int p, int q) const {
+        return (conflicts[(size_t)p * rowWords + (q >> 6)] >> (q & 63)) & 1;
+    }
+
+    size_t bytes() const {
+        return ids.capacity() * sizeof(int) + patternOf.capacity() * sizeof(uint32_t) + dates.capacity() * sizeof(int) +
+               roomOffsets.capacity() * sizeof(uint32_t) + rooms.capacity() * sizeof(uint16_t) +
+               patternOffsets.capacity() * sizeof(uint32_t) + patternTimes.capacity() * sizeof(uint16_t) +
+               patterns.capacity() * sizeof(Occupancy) + conflicts.capacity() * sizeof(uint64_t);
+    }
+
+    void clear() {
+        vector<int>().swap(ids);
+        vector<uint32_t>().swap(patternOf);
+        vector<int>().swap(dates);
+        vector<uint32_t>().swap(roomOffsets);
+        vector<uint16_t>().swap(rooms);
+        vector<uint32_t>().swap(patternOffsets);
+        vector<uint16_t>().swap(patternTimes);
+        vector<Occupancy>().swap(patterns);
+        vector<uint64_t>().swap(conflicts);
+        rowWords = 0;
+    }
+
+    /**
+     * compute the bitmaps of the patterns and the conflicts between them from their time arrays
+     */
+    void buildConflicts() {
+        int numPatterns = patternOffsets.size() - 1;
+        patterns.resize(numPatterns);
+        for (int p = 0; p < numPatterns; p++) buildOccupancy(patterns[p], patternTimeArray(p), patternTimeArray(p) + 8, 3);
+
+        // the bitmaps decide the conflicts between the aligned patterns. The others are checked by their meetings
+        rowWords = (numPatterns + 63) / 64;
+        conflicts.assign((size_t)numPatterns * rowWords, 0);
+        for (int p = 0; p < numPatterns; p++) {
+            const auto& a = patterns[p];
+            for (int q = 0; q <= p; q++) {
+                const auto& b = patterns[q];
+                bool conflict = false;
+                for (int w = std::max(a.lo, b.lo); w < std::min(a.hi, b.hi) && !conflict; w++) conflict = a.bits[w] & b.bits[w];
+                if (conflict && !(a.exact && b.exact))
+                    conflict = timesOverlap(patternTimeArray(p), patternTimeArray(p) + 8, patternTimeArray(q), patternTimeArray(q) + 8);
+                if (!conflict) continue;
+                conflicts[(size_t)p * rowWords + (q >> 6)] |= 1ull << (q & 63);
+                conflicts[(size_t)q * rowWords + (p >> 6)] |= 1ull << (p & 63);
+            }
+        }
+    }
+
+    /**
+     * serialize the table into uint32 words. The bitmaps and the conflicts are derived data and are not stored
+     * - header: [MAGIC, VERSION, total number of words, number of sections, number of patterns, number of rooms,
+     *   number of uint16 words of patternTimes, 0]
+     * - ids, patternOf, dates, roomOffsets and patternOffsets
+     * - rooms and patternTimes, each padded to 4 bytes
+     */
+    void serialize(vector<uint32_t>& out) const {
+        out.assign(HEADER_WORDS, 0);
+        auto put = [&](const void* data, size_t bytes) {
+            size_t offset = out.size();
+            out.resize(offset + (bytes + 3) / 4);
+            memcpy(out.data() + offset, data, bytes);
+        };
+        put(ids.data(), ids.size() * sizeof(int));
+        put(patternOf.data(), patternOf.size() * sizeof(uint32_t));
+        put(dates.data(), dates.size() * sizeof(int));
+        put(roomOffsets.data(), roomOffsets.size() * sizeof(uint32_t));
+        put(patternOffsets.data(), patternOffsets.size() * sizeof(uint32_t));
+        put(rooms.data(), rooms.size() * sizeof(uint16_t));
+        put(patternTimes.data(), patternTimes.size() * sizeof(uint16_t));
+        uint32_t header[HEADER_WORDS] = {MAGIC, VERSION, (uint32_t)out.size(), (uint32_t)ids.size(), (uint32_t)patternOffsets.size() - 1,
+                                         (uint32_t)rooms.size(), (uint32_t)patternTimes.size(), 0};
+        memcpy(out.data(), header, sizeof(header));
+    }
+
+    /**
+     * the inverse of serialize, which also rebuilds the bitmaps and the conflicts
+     * @returns false if the file is malformed, in which case the table is left empty
+     */
+    bool deserialize(const uint32_t* __restrict__ file) {
+        auto fail = [this]() {
+            clear();
+            return false;
+        };
+        clear();
+        if (file[0] != MAGIC || file[1] != VERSION) return false;
+        size_t len = file[2], numSections = file[3], numPatterns = file[4], numRooms = file[5], numTimes = file[6], pos = HEADER_WORDS;
+        if (len != pos + 5 * numSections + 2 + numPatterns + (numRooms + 1) / 2 + (numTimes + 1) / 2) return false;
+        auto get = [&](auto& vec, size_t n) {
+            vec.resize(n);
+            memcpy(vec.data(), file + pos, n * sizeof(vec[0]));
+            pos += (n * sizeof(vec[0]) + 3) / 4;
+        };
+        get(ids, numSections);
+        get(patternOf, numSections);
+        get(dates, 2 * numSections);
+        get(roomOffsets, numSections + 1);
+        get(patternOffsets, numPatterns + 1);
+        get(rooms, numRooms);
+        get(patternTimes, numTimes);
+        // check the offsets, so that the arrays can be indexed without bounds checks
+        if (!std::is_sorted(ids.begin(), ids.end()) || roomOffsets.front() != 0 || roomOffsets.back() != numRooms ||
+            !std::is_sorted(roomOffsets.begin(), roomOffsets.end()) || patternOffsets.front() != 0 || patternOffsets.back() != numTimes)
+            return fail();
+        for (size_t p = 0; p < numPatterns; p++) {
+            uint32_t start = patternOffsets[p], end = patternOffsets[p + 1];
+            if (start + 8 > end) return fail();
+            const auto* header = patternTimes.data() + start;
+            for (int day = 0; day < 7; day++)
+                if (header[day] > header[day + 1] || (header[day + 1] - header[day]) % 3) return fail();
+            if (header[0] != 0 || start + 8 + header[7] != end) return fail();
+        }
+        for (size_t i = 0; i < numSections; i++) {
+            if (patternOf[i] >= numPatterns) return fail();
+            if (roomOffsets[i + 1] - roomOffsets[i] != (uint32_t)patternTimeArray(patternOf[i])[7] / 3) return fail();
+        }
+        buildConflicts();
+        return true;
+    }
+};
+
+CatalogIndex catalogIndex;
+
+/**
+ * checks time conflicts between sections, using either a pre-computed conflict matrix
+ * or the occupancy bitmaps of the sections, which take O(numSections) memory.
+ * The bitmaps and the exact conflicts of the sections in catalogIndex are taken from the index
+ */
+struct ConflictChecker {
+    int numSections;
+    /** the conflict matrix. If NULL, the occupancy bitmaps are used */
+    const uint8_t* __restrict__ conflictCache;
+    const uint16_t* __restrict__ timeArray;
+    /** [start, end] date of each section. If NULL, all sections are assumed to have the same date range */
+    const int* __restrict__ dates;
+    /** occupancy bitmap of each section. NULL if conflictCache is given */
+    Occupancy* __restrict__ occupancy;
+    /** the time pattern of each section in catalogIndex, or -1 if it is not in the index */
+    int* __restrict__ pattern;
+    /** whether the bitmaps of all sections are exact */
+    bool allExact;
+
+    /**
+     * @param catalogIds the catalog id of each section, used to look up catalogIndex. If NULL, the index is not used
+     */
+    ConflictChecker(int _numSections, const uint8_t* _conflictCache, const uint16_t* _timeArray, const int* _dates, const int* catalogIds = NULL)
+        : numSections(_numSections), conflictCache(_conflictCache), timeArray(_timeArray), dates(_dates), occupancy(NULL), pattern(NULL), allExact(false) {
+        if (conflictCache != NULL) return;
+        occupancy = Arena::allocArray<Occupancy>(numSections);
+        pattern = Arena::allocArray<int>(numSections);
+
+        // a date range overlaps with all others iff it starts before the earliest end and ends after the latest start
+        int minEnd = numeric_limits<int>::max(), maxStart = numeric_limits<int>::min();
+        for (int i = 0; dates != NULL && i < numSections; i++) {
+            maxStart = std::max(maxStart, dates[2 * i]);
+            minEnd = std::min(minEnd, dates[2 * i + 1]);
+        }
+        const auto* content = timeArray + numSections * 8;
+        allExact = true;
+        for (int i = 0; i < numSections; i++) {
+            auto& occ = occupancy[i];
+            int idx = catalogIds == NULL ? -1 : catalogIndex.indexOf(catalogIds[i]);
+            pattern[i] = idx < 0 ? -1 : catalogIndex.patternOf[idx];
+            if (pattern[i] >= 0) {
+                occ = catalogIndex.patterns[pattern[i]];
+            } else {
+                buildOccupancy(occ, timeArray + i * 8, content, 3);
+            }
+            occ.exact &= dates == NULL || (dates[2 * i] <= minEnd && dates[2 * i + 1] >= maxStart);
+            allExact &= occ.exact;
+        }
+    }
+
+    /**
+     * whether the bitmap of section a overlaps with the given bitmap
+     */
+    inline bool intersects(int a, const Occupancy& other) const {
+        const auto& occ = occupancy[a];
+        for (int w = occ.lo; w < occ.hi; w++)
+            if (occ.bits[w] & other.bits[w]) return true;
+        return false;
+    }
+
+    /**
+     * the exact check using the time arrays and the dates
+     */
+    bool overlaps(int a, int b) const {
+        if (dates != NULL && calcOverlap(dates[2 * a], dates[2 * a + 1], dates[2 * b], dates[2 * b + 1]) == -1) return false;
+        // gather the conflict from the index if both sections are in it
+        if (pattern[a] >= 0 && pattern[b] >= 0) return catalogIndex.conflict(pattern[a], pattern[b]);
+        const auto* content = timeArray + numSections * 8;
+        return timesOverlap(timeArray + a * 8, content, timeArray + b * 8, content);
+    }
+
+    bool isConflict(int a, int b) const {
+        if (conflictCache != NULL) return conflictCache[a * numSections + b];
+        if (!intersects(a, occupancy[b])) return false;
+        return (occupancy[a].exact && occupancy[b].exact) || overlaps(a, b);
+    }
+};
+
+/**
+ * arc-consistency preprocessing of the section domains of each course.
+ *
+ * A section that conflicts with every remaining section of some other course can never appear in a valid schedule.
+ * Such sections are iteratively removed (recorded in prunedBy) until no more can be removed. Each section keeps
+ * the number of its supports, i.e. the remaining non-conflicting sections, in each other course,
+ * so the whole pass takes O(numSections^2) time.
+ * @note prunedBy must be filled with -1 beforehand
+ * @returns false if all sections of some course are removed, i.e. there is no valid schedule
+ */
+bool pruneSections(const int* __restrict__ sectionLens, const ConflictChecker& checker) {
+    TRACE_SPAN("ScheduleGenerator::pruneSections");
+    const int numSections = sectionLens[numCourses];
+    if (numCourses <= 1) return true;
+
+    auto* courseOf = Arena::allocArray<int>(numSections);
+    // support[s * numCourses + d] is the number of remaining sections of course d that do not conflict with section s
+    auto* support = Arena::allocArray<int>(numSections * numCourses);
+    // the number of remaining sections of each course
+    auto* remaining = Arena::allocArray<int>(numCourses);
+    // removed sections whose removal has not been propagated yet
+    auto* queue = Arena::allocArray<int>(numSections);
+    int qHead = 0, qTail = 0;
+
+    for (int c = 0; c < numCourses; c++) {
+        remaining[c] = sectionLens[c + 1] - sectionLens[c];
+        for (int s = sectionLens[c]; s < sectionLens[c + 1]; s++) courseOf[s] = c;
+    }
+    auto remove = [&](int s, int by) {
+        prunedBy[s] = by;
+        queue[qTail++] = s;
+        return --remaining[courseOf[s]] > 0;
+    };
+    for (int s = 0; s < numSections; s++) {
+        int c = courseOf[s];
+        for (int d = 0; d < numCourses; d++) {
+            if (d == c) continue;
+            int cnt = 0;
+            for (int t = sectionLens[d]; t < sectionLens[d + 1]; t++) cnt += !checker.isConflict(s, t);
+            support[s * numCourses + d] = cnt;
+            if (cnt == 0 && prunedBy[s] < 0 && !remove(s, d)) return false;
+        }
+    }
+    // propagate: the removal of t decreases the support of every remaining section that does not conflict with it
+    while (qHead < qTail) {
+        int t = queue[qHead++], d = courseOf[t];
+        for (int s = 0; s < numSections; s++) {
+            if (prunedBy[s] >= 0 || courseOf[s] == d || checker.isConflict(t, s)) continue;
+            if (--support[s * numCourses + d] == 0 && !remove(s, d)) return false;
+        }
+    }
+    TRACE_COUNTER("ScheduleGenerator::pruned", qTail);
+    return true;
+}
+
+/** maximum number of entries of the subproblem memo */
+constexpr int MEMO_CAPACITY = 1 << 20;
+
+/**
+ * memoisation of the subproblems of the search. Only usable when the occupancy bitmaps of all sections are exact.
+ *
+ * The valid completions of courses depth ... numCourses - 1 only depend on the slots occupied by the sections chosen so far
+ * that can still be occupied by the remaining courses, so a subproblem is keyed by
+ * (depth, occupied & futureMask[depth]), and partial schedules reaching the same key share the same entry.
+ */
+struct SubproblemMemo {
+    struct Result {
+        /** number of valid completions */
+        double count;
+        /** minimum total cost of the sections of a valid completion. Infinity if count = 0 */
+        float minCost;
+    };
+    struct Entry {
+        uint64_t hash;
+        /** offset of the key in keys, or -1 if this slot is empty */
+        int keyOffset;
+        int depth;
+        Result result;
+        /** number of partial schedules of courses 0 ... depth - 1 reaching this subproblem. Only computed by countSections */
+        double paths;
+    };
+
+    const int* __restrict__ sectionLens;
+    const ConflictChecker& checker;
+    /** cost of each section used by minCost. If NULL, all costs are 0 */
+    const float* __restrict__ sectionCosts = NULL;
+    /** futureMask[d] is the union of the bitmaps of the remaining sections of courses d ... numCourses - 1 */
+    Occupancy* futureMask;
+    /** open addressing hash table. Its size is a power of 2 */
+    Arena::ScratchVector<Entry> table;
+    /** masked bitmap words of the keys */
+    Arena::ScratchVector<uint64_t> keys;
+    int size = 0;
+    /** set when MEMO_CAPACITY is reached, in which case the results are incomplete and must be discarded */
+    bool full = false;
+
+    SubproblemMemo(const int* _sectionLens, const ConflictChecker& _checker)
+        : sectionLens(_sectionLens), checker(_checker), table(1024) {
+        for (auto& entry : table) entry.keyOffset = -1;
+        futureMask = Arena::allocArray<Occupancy>(numCourses + 1);
+        auto& last = futureMask[numCourses];
+        memset(last.bits, 0, sizeof(last.bits));
+        last.lo = last.hi = 0;
+        for (int d = numCourses - 1; d >= 0; d--) {
+            auto& mask = futureMask[d];
+            mask = futureMask[d + 1];
+            for (int s = sectionLens[d]; s < sectionLens[d + 1]; s++) {
+                if (prunedBy[s] >= 0) continue;
+                const auto& occ = checker.occupancy[s];
+                if (occ.lo == occ.hi) continue;
+                if (mask.lo == mask.hi) mask.lo = occ.lo, mask.hi = occ.hi;
+                mask.lo = std::min(mask.lo, occ.lo);
+                mask.hi = std::max(mask.hi, occ.hi);
+                for (int w = occ.lo; w < occ.hi; w++) mask.bits[w] |= occ.bits[w];
+            }
+        }
+    }
+
+    uint64_t hashKey(int depth, const Occupancy& occupied) const {
+        const auto& mask = futureMask[depth];
+        uint64_t h = depth * 0x9E3779B97F4A7C15ull;
+        for (int w = mask.lo; w < mask.hi; w++) {
+            h = (h ^ (occupied.bits[w] & mask.bits[w])) * 0xFF51AFD7ED558CCDull;
+            h ^= h >> 32;
+        }
+        return h;
+    }
+
+    /**
+     * @returns the index of the slot of the key in table, which is empty if the key is not found
+     */
+    int findSlot(int depth, const Occupancy& occupied, uint64_t hash) const {
+        const auto& mask = futureMask[depth];
+        size_t m = table.size() - 1;
+        for (size_t i = hash & m;; i = (i + 1) & m) {
+            const auto& entry = table[i];
+            if (entry.keyOffset < 0) return i;
+            if (entry.hash != hash || entry.depth != depth) continue;
+            const auto* key = keys.data() + entry.keyOffset;
+            int w = mask.lo;
+            for (; w < mask.hi; w++)
+                if (key[w - mask.lo] != (occupied.bits[w] & mask.bits[w])) break;
+            if (w == mask.hi) return i;
+        }
+    }
+
+    void insert(int depth, const Occupancy& occupied, uint64_t hash, const Result& result) {
+        if (size >= MEMO_CAPACITY) {
+            full = true;
+            return;
+        }
+        // keep the load factor below 1/2
+        if (2 * (size + 1) > (int)table.size()) {
+            Arena::ScratchVector<Entry> old(table.size() * 2);
+            old.swap(table);
+            for (auto& entry : table) entry.keyOffset = -1;
+            size_t m = table.size() - 1;
+            for (const auto& entry : old) {
+                if (entry.keyOffset < 0) continue;
+                size_t i = entry.hash & m;
+                while (table[i].keyOffset >= 0) i = (i + 1) & m;
+                table[i] = entry;
+            }
+        }
+        const auto& mask = futureMask[depth];
+        auto& entry = table[findSlot(depth, occupied, hash)];
+        entry = {hash, (int)keys.size(), depth, result, 0.0};
+        for (int w = mask.lo; w < mask.hi; w++) keys.push_back(occupied.bits[w] & mask.bits[w]);
+        size++;
+    }
+
+    /**
+     * @returns the memoised result of the subproblem, or NULL if it is not in the memo
+     */
+    const Result* find(int depth, const Occupancy& occupied) const {
+        const auto& entry = table[findSlot(depth, occupied, hashKey(depth, occupied))];
+        return entry.keyOffset < 0 ? NULL : &entry.result;
+    }
+
+    /**
+     * count the valid completions of courses depth ... numCourses - 1 given the occupied slots, memoising all subproblems
+     */
+    Result solve(int depth, const Occupancy& occupied) {
+        if (depth == numCourses) return {1.0, 0.0f};
+        if (full) return {0.0, numeric_limits<float>::infinity()};
+        uint64_t hash = hashKey(depth, occupied);
+        const auto& entry = table[findSlot(depth, occupied, hash)];
+        if (entry.keyOffset >= 0) return entry.result;
+
+        Result result = {0.0, numeric_limits<float>::infinity()};
+        Occupancy next;
+        for (int s = sectionLens[depth]; s < sectionLens[depth + 1]; s++) {
+            if (prunedBy[s] >= 0 || checker.intersects(s, occupied)) continue;
+            const auto& occ = checker.occupancy[s];
+            next = occupied;
+            for (int w = occ.lo; w < occ.hi; w++) next.bits[w] |= occ.bits[w];
+            auto sub = solve(depth + 1, next);
+            if (sub.count == 0.0) continue;
+            result.count += sub.count;
+            result.minCost = std::min(result.minCost, (sectionCosts == NULL ? 0.0f : sectionCosts[s]) + sub.minCost);
+        }
+        insert(depth, occupied, hash, result);
+        return result;
+    }
+
+    /**
+     * whether the subproblem is known to have no valid completion
+     */
+    bool isDeadEnd(int depth, const Occupancy& occupied) const {
+        if (depth == numCourses) return false;
+        const auto* result = find(depth, occupied);
+        return result != NULL && result->count == 0.0;
+    }
+
+    /**
+     * count the valid schedules containing each section, by propagating the number of partial schedules reaching each subproblem
+     * from the shallowest subproblems to the deepest ones.
+     * The count of a section is the sum over the subproblems where it can be chosen of (paths * completions after choosing it)
+     * @param out the count of each section
+     * @note must be called after solve(0, empty)
+     */
+    void countSections(double* __restrict__ out) {
+        memset(out, 0, sectionLens[numCourses] * sizeof(double));
+        Occupancy cur, next;
+        memset(cur.bits, 0, sizeof(cur.bits));
+        table[findSlot(0, cur, hashKey(0, cur))].paths = 1.0;
+        for (int d = 0; d < numCourses; d++) {
+            const auto& mask = futureMask[d];
+            for (const auto& entry : table) {
+                if (entry.keyOffset < 0 || entry.depth != d || entry.paths == 0.0 || entry.result.count == 0.0) continue;
+                // the subproblem only depends on the masked bits, so the others can be left empty
+                memset(cur.bits, 0, sizeof(cur.bits));
+                memcpy(cur.bits + mask.lo, keys.data() + entry.keyOffset, (mask.hi - mask.lo) * sizeof(uint64_t));
+                double paths = entry.paths;
+                for (int s = sectionLens[d]; s < sectionLens[d + 1]; s++) {
+                    if (prunedBy[s] >= 0 || checker.intersects(s, cur)) continue;
+                    const auto& occ = checker.occupancy[s];
+                    next = cur;
+                    for (int w = occ.lo; w < occ.hi; w++) next.bits[w] |= occ.bits[w];
+                    if (d + 1 == numCourses) {
+                        out[s] += paths;
+                        continue;
+                    }
+                    auto& child = table[findSlot(d + 1, next, hashKey(d + 1, next))];
+                    if (child.result.count == 0.0) continue;
+                    out[s] += paths * child.result.count;
+                    child.paths += paths;
+                }
+            }
+        }
+    }
+
+    /**
+     * write the rank-th (0-based, in the order of the depth-first search) valid schedule to out
+     * @note must be called after solve(0, empty)
+     */
+    void unrank(double rank, uint16_t* __restrict__ out) const {
+        Occupancy cur, next;
+        memset(cur.bits, 0, sizeof(cur.bits));
+        for (int d = 0; d < numCourses; d++) {
+            int chosen = -1;
+            for (int s = sectionLens[d]; s < sectionLens[d + 1]; s++) {
+                if (prunedBy[s] >= 0 || checker.intersects(s, cur)) continue;
+                const auto& occ = checker.occupancy[s];
+                next = cur;
+                for (int w = occ.lo; w < occ.hi; w++) next.bits[w] |= occ.bits[w];
+                double cnt = d + 1 == numCourses ? 1.0 : find(d + 1, next)->count;
+                if (cnt == 0.0) continue;
+                // the last viable section absorbs the rounding errors of large counts
+                chosen = s;
+                if (rank < cnt) break;
+                rank -= cnt;
+            }
+            const auto& occ = checker.occupancy[chosen];
+            for (int w = occ.lo; w < occ.hi; w++) cur.bits[w] |= occ.bits[w];
+            out[d] = chosen;
+        }
+    }
+
+    /**
+     * write the valid schedules with the least total section costs to the schedule storage, in ascending order of their costs,
+     * by a best-first search over partial schedules. Because minCost is the exact cost of the best completion,
+     * each schedule is found by following a single path, without visiting the rest of the search space
+     * @note must be called after solve(0, empty)
+     * @returns the number of schedules written, at most maxCount. Returns -1 on memory allocation failure
+     */
+    int enumerateBest(int maxCount) const {
+        struct Node {
+            /** index of the parent node in nodes, or -1 for the root */
+            int parent;
+            int section;
+            int depth;
+            /** total cost of the sections chosen so far */
+            float cost;
+        };
+        struct QueueItem {
+            /** cost of the partial schedule plus the cost of its best completion */
+            float bound;
+            int node;
+            // ties are broken by the order of creation, so the schedules of the same cost are in the depth-first order
+            bool operator<(const QueueItem& other) const {
+                return bound > other.bound || (bound == other.bound && node > other.node);
+            }
+        };
+        Arena::ScratchVector<Node> nodes;
+        priority_queue<QueueItem, Arena::ScratchVector<QueueItem>> queue;
+        nodes.push_back({-1, -1, 0, 0.0f});
+        queue.push({0.0f, 0});
+
+        int numFound = 0;
+        Occupancy cur, next;
+        while (numFound < maxCount && !queue.empty()) {
+            int idx = queue.top().node;
+            queue.pop();
+            const auto node = nodes[idx];
+            if (node.depth == numCourses) {
+                auto* schedule = reserveSchedule(numFound++);
+                if (schedule == NULL) return -1;
+                for (int n = idx; nodes[n].parent >= 0; n = nodes[n].parent) schedule[nodes[n].depth - 1] = nodes[n].section;
+                continue;
+            }
+            // rebuild the occupied slots along the path
+            memset(cur.bits, 0, sizeof(cur.bits));
+            for (int n = idx; nodes[n].parent >= 0; n = nodes[n].parent) {
+                const auto& occ = checker.occupancy[nodes[n].section];
+                for (int w = occ.lo; w < occ.hi; w++) cur.bits[w] |= occ.bits[w];
+            }
+            for (int s = sectionLens[node.depth]; s < sectionLens[node.depth + 1]; s++) {
+                if (prunedBy[s] >= 0 || checker.intersects(s, cur)) continue;
+                const auto& occ = checker.occupancy[s];
+                next = cur;
+                for (int w = occ.lo; w < occ.hi; w++) next.bits[w] |= occ.bits[w];
+                float rest = 0.0f;
+                if (node.depth + 1 < numCourses) {
+                    const auto* sub = find(node.depth + 1, next);
+                    if (sub->count == 0.0) continue;
+                    rest = sub->minCost;
+                }
+                float cost = node.cost + (sectionCosts == NULL ? 0.0f : sectionCosts[s]);
+                queue.push({cost + rest, (int)nodes.size()});
+                nodes.push_back({idx, s, node.depth + 1, cost});
+            }
+        }
+        return numFound;
+    }
+};
+
+/**
+ * total number of valid schedules of the last generation, or -1 if unknown
+ */
+double totalCount = -1;
+/**
+ * flags of exportPage
+ */
+enum ExportFlag {
+    /** include the day blocks of each schedule */
+    exportBlocks = 1,
+    /** include the values of the sort functions of each schedule */
+    exportMetrics = 2
+};
+/** number of sort functions whose values are exported, i.e. all but IamFeelingLucky */
+constexpr int NUM_METRICS = 6;
+/**
+ * backing storage of the page returned by exportPage
+ */
+vector<uint32_t> pageBuffer;
+/**
+ * the events displayed with the schedules, laid out together with their classes by renderSchedule.
+ * 8 offsets of the days followed by the (start, end) pairs
+ */
+uint16_t* renderEvents = NULL;
+/**
+ * backing storage of the layouts returned by renderSchedule
+ */
+vector<double> renderBuffer;
+
+/**
+ * the result of filterSections: the number of surviving sections, followed by their indices
+ */
+vector<int> survivors;
+/**
+ * cost of each section for the objective that decomposes per section (e.g. the dissimilarity to the reference schedule).
+ * If not NULL, the next generation produces the schedules with the least total costs, in ascending order of their costs.
+ * Length = number of sections. It is consumed (freed) by generate
+ */
+float* __restrict__ sectionCosts = NULL;
+/**
+ * whether the optimal mode is requested for the next generation, in which case the schedules with the least total
+ * sectionCosts are found by solveMILP when they cannot be enumerated in order. Reset by generate
+ */
+bool optimalMode = false;
+/**
+ * optionalCourses[i] is non-zero if course i of the next generation may be left out. The last section of an optional course
+ * is its skip section, which has no meetings and stands for not taking the course.
+ * Length = number of courses. It is consumed (freed) by generate. NULL if all courses are required
+ */
+uint8_t* __restrict__ optionalCourses = NULL;
+/** the minimum and maximum number of optional courses taken, i.e. whose skip sections are not chosen */
+int minOptional = 0, maxOptional = 0;
+
+/**
+ * @returns whether section s of course i is taken, i.e. it is not the skip section of an optional course
+ */
+inline bool isTaken(const int* __restrict__ sectionLens, int i, int s) {
+    return optionalCourses == NULL || !optionalCourses[i] || s != sectionLens[i + 1] - 1;
+}
+
+/**
+ * @returns whether the number of optional courses taken by the schedule is within [minOptional, maxOptional]
+ */
+bool withinOptionalLimits(const int* __restrict__ sectionLens, const uint16_t* schedule) {
+    if (optionalCourses == NULL) return true;
+    int taken = 0;
+    for (int i = 0; i < numCourses; i++) taken += optionalCourses[i] && isTaken(sectionLens, i, schedule[i]);
+    return taken >= minOptional && taken <= maxOptional;
+}
+/** the catalog id of each section of the next generation, used to look up catalogIndex. See setSectionIds */
+int* __restrict__ sectionIds = NULL;
+
+/**
+ * free the options of the next generation (sectionCosts, optionalCourses and sectionIds).
+ * They are consumed by generate whether it succeeds or not, because they do not fit the next one
+ */
+void resetGenerationOptions() {
+#ifndef _TEST
+    free(sectionCosts);
+    free(sectionIds);
+    free(optionalCourses);
+#endif
+    sectionCosts = NULL;
+    optimalMode = false;
+    sectionIds = NULL;
+    optionalCourses = NULL;
+}
+/**
+ * sectionCounts[i] is the number of valid schedules of the last generation containing section i.
+ * The counts are over all valid schedules if getTotalCount() is known, otherwise only over the schedules generated
+ */
+vector<double> sectionCounts;
+/**
+ * whether to draw evenly spread samples from all valid schedules, instead of keeping the first maxNumSchedules schedules,
+ * when there are more valid schedules than maxNumSchedules
+ */
+bool sampling = false;
+
+extern "C" {
+
+/**
+ * remove the sections that conflict with the given blocks (e.g. the events and the time filters of the user)
+ * @param numSections number of candidate sections
+ * @param timeArray the compact time arrays of the candidate sections, in the same layout as the timeArray of generate.
+ * It is compacted in place to contain only the surviving sections, so it can be passed to generate directly
+ * @param blocks the blocks to avoid, as a single time array of (start, end) pairs: 8 offsets followed by the pairs.
+ * It will be freed before this function returns
+ * @returns pointer to an int array: the number of surviving sections, followed by their indices in ascending order
+ */
+const int* filterSections(int numSections, uint16_t* __restrict__ timeArray, const uint16_t* __restrict__ blocks) {
+    TRACE_SPAN("ScheduleGenerator::filterSections");
+    Arena::Scope scope;
+    Occupancy blocked, occ;
+    buildOccupancy(blocked, blocks, blocks + 8, 2);
+
+    survivors.assign(1, 0);
+    // the offsets are overwritten in the compaction, so make a copy first
+    auto* header = Arena::allocArray<uint16_t>(numSections * 8);
+    memcpy(header, timeArray, numSections * 8 * sizeof(uint16_t));
+    const auto* content = timeArray + numSections * 8;
+    for (int i = 0; i < numSections; i++) {
+        const auto* secHeader = header + i * 8;
+        buildOccupancy(occ, secHeader, content, 3);
+        bool conflict = false;
+        for (int w = occ.lo; w < occ.hi && !conflict; w++) conflict = occ.bits[w] & blocked.bits[w];
+        // the overlap of the bitmaps may be caused by the rounding of unaligned times
+        if (conflict && !(occ.exact && blocked.exact)) {
+            conflict = false;
+            for (int day = 0; day < 7 && !conflict; day++) {
+                for (int j = secHeader[day]; j < secHeader[day + 1] && !conflict; j += 3) {
+                    for (int k = blocks[day]; k < blocks[day + 1]; k += 2) {
+                        if (calcOverlap<int>(content[j], content[j + 1], blocks[8 + k], blocks[8 + k + 1]) > 0) {
+                            conflict = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (!conflict) survivors.push_back(i);
+    }
+    int numSurvivors = survivors[0] = survivors.size() - 1;
+
+    // the content of the survivors moves toward the front, so it never overwrites the content not yet moved
+    auto* newContent = timeArray + numSurvivors * 8;
+    int len = 0;
+    for (int n = 0; n < numSurvivors; n++) {
+        const auto* secHeader = header + survivors[n + 1] * 8;
+        int start = secHeader[0], secLen = secHeader[7] - start;
+        for (int day = 0; day < 8; day++) timeArray[n * 8 + day] = secHeader[day] - start + len;
+        memmove(newContent + len, content + start, secLen * sizeof(uint16_t));
+        len += secLen;
+    }
+#ifndef _TEST
+    free((void*)blocks);
+#endif
+    TRACE_COUNTER("ScheduleGenerator::filtered", numSections - numSurvivors);
+    return survivors.data();
+}
+
+/**
+ * add the day pattern in buffer to the dictionary if it is not there yet
+ * @param buffer the (start, end, room) triples of the classes in a day, sorted by the start time
+ * @param table open addressing hash table of the ids of the patterns, whose size is a power of 2. UINT32_MAX marks an empty slot
+ * @param hashes the hash of each pattern
+ * @returns the id of the pattern
+ */
+uint32_t internPattern(const Arena::ScratchVector<uint16_t>& buffer, Arena::ScratchVector<uint32_t>& table, Arena::ScratchVector<uint64_t>& hashes) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (auto v : buffer) hash = (hash ^ v) * 0x100000001B3ull;
+    uint32_t len = buffer.size() / 3;
+    size_t m = table.size() - 1;
+    size_t i = hash & m;
+    for (; table[i] != UINT32_MAX; i = (i + 1) & m) {
+        uint32_t p = table[i];
+        if (hashes[p] != hash || patternBounds[p + 1] - patternBounds[p] != len) continue;
+        uint32_t k = 0;
+        for (uint32_t j = patternBounds[p]; k < len; j++, k++) {
+            if (patternStarts[j] != buffer[k * 3] || patternEnds[j] != buffer[k * 3 + 1] || patternRooms[j] != buffer[k * 3 + 2]) break;
+        }
+        if (k == len) return p;
+    }
+    uint32_t id = hashes.size();
+    table[i] = id;
+    hashes.push_back(hash);
+    uint32_t begin = patternStarts.size();
+    for (uint32_t k = 0; k < len; k++) {
+        patternStarts.push_back(buffer[k * 3]);
+        patternEnds.push_back(buffer[k * 3 + 1]);
+        patternRooms.push_back(buffer[k * 3 + 2]);
+    }
+    patternBounds.push_back(patternStarts.size());
+
+    // compute the per-day parts of the sort functions
+    int metrics[NUM_PATTERN_METRICS] = {};
+    dayMetrics(patternStarts.data() + begin, patternEnds.data() + begin, len, metrics);
+    for (int m = 0; m < NUM_PATTERN_METRICS; m++) patternMetrics[m].push_back(metrics[m]);
+    patternDistanceValid = false;
+
+    // keep the load factor below 1/2
+    if (2 * hashes.size() > table.size()) {
+        table.assign(table.size() * 2, UINT32_MAX);
+        m = table.size() - 1;
+        for (uint32_t p = 0; p < hashes.size(); p++) {
+            size_t j = hashes[p] & m;
+            while (table[j] != UINT32_MAX) j = (j + 1) & m;
+            table[j] = p;
+        }
+    }
+    return id;
+}
+
+/**
+ * build the day patterns of all schedules so that the sort functions can use them
+*/
+void addToEval(const uint16_t* __restrict__ timeArray, const int* __restrict__ sectionLens) {
+    TRACE_SPAN("ScheduleGenerator::addToEval");
+    Arena::Scope scope;
+    // point to the second part of the timeArray where the content is stored
+    // should not alias with timeArray, which should be only used to access the first part
+    const auto* __restrict__ timeArrayContent = timeArray + (sectionLens[numCourses]) * 8;
+    patternStarts.clear();
+    patternEnds.clear();
+    patternRooms.clear();
+    patternBounds.assign(1, 0);
+    for (auto& metric : patternMetrics) metric.clear();
+    evalLayout = nextEvalLayout;
+    Arena::ScratchVector<uint32_t> table(1024, UINT32_MAX);
+    Arena::ScratchVector<uint64_t> hashes;
+    // the time and room information of the current day
+    Arena::ScratchVector<uint16_t> buffer;
+    // the stride between the patterns of two consecutive schedules and two consecutive days
+    int scheduleStride = evalLayout == splitLayout ? 1 : 7,
+        dayStride = evalLayout == splitLayout ? count : 1;
+    for (int i = 0; i < count; i++) {  // for each schedule
+        const auto* __restrict__ curSchedule = scheduleAt(i);
+        for (int j = 0; j < 7; j++) {  // sort the time blocks in order for each day
+            buffer.clear();
+            // for each section selected (for each course), extract its time blocks on day j,
+            // and insert into the buffer
+            for (int k = 0; k < numCourses; k++) {
+                // offset of the time arrays
+                int _off = curSchedule[k] * 8 + j;
+                // insertion sort, fast for small arrays
+                for (int n = timeArray[_off], e2 = timeArray[_off + 1]; n < e2; n += 3) {
+                    int bound = buffer.size(), p = 0;
+                    uint16_t vToBeInserted = timeArrayContent[n];
+                    for (; p < bound; p += 3) {
+                        if (vToBeInserted < buffer[p]) break;
+                    }
+                    // insert three elements at p
+                    buffer.insert(buffer.begin() + p, timeArrayContent + n, timeArrayContent + n + 3);
+                }
+            }
+            dayPatterns[i * scheduleStride + j * dayStride] = internPattern(buffer, table, hashes);
+        }
+    }
+    trackPatternMemory();
+    TRACE_COUNTER("ScheduleGenerator::dayPatterns", hashes.size());
+}
+
+/**
+ * time budget of the local search in milliseconds. 0 disables it
+ */
+double searchBudget = 0;
+
+/**
+ * Large neighbourhood search for the schedules with the best sort objective,
+ * used when there are more valid schedules than the generation can keep.
+ *
+ * Starting from the schedules already generated, each step frees the sections of 2 or 3 random courses,
+ * evaluates the valid ways (up to MAX_NEIGHBOURS of them) to choose them again while the other courses stay fixed,
+ * and moves to the best one by the acceptance rule of simulated annealing.
+ * Every schedule evaluated competes for a pool of the best POOL_SIZE distinct schedules, which starts with the best generated ones.
+ * The pool is written to the front of the generated schedules, and the new schedules in it replace generated ones outside of it.
+ * When the pool stops improving, the search restarts from a random schedule to keep the pool diverse.
+ *
+ * The objective is the one of the combined sort mode, with each sort function normalized by the range of its values
+ * over the schedules generated and some random ones. In the fallback mode, each sort option weighs 1000 times less than the previous one
+ */
+struct LocalSearch {
+    /** maximum number of candidates evaluated in a neighbourhood */
+    static constexpr int MAX_NEIGHBOURS = 256;
+    /** number of steps without improving the pool before a restart */
+    static constexpr int RESTART_STEPS = 64;
+    /** number of random schedules used to estimate the range of each sort function, along with as many generated ones */
+    static constexpr int NUM_RANDOM = 256;
+    /** maximum number of schedules in the pool, so that the memory used does not grow with the number of schedules generated */
+    static constexpr int POOL_SIZE = 1024;
+
+    const int* __restrict__ sectionLens;
+    const ConflictChecker& checker;
+    const uint16_t* __restrict__ timeArray;
+    const uint16_t* __restrict__ content;
+
+    /** an enabled sort option, normalized by the range of its values */
+    struct Term {
+        int func;
+        float weight;
+        bool reverse;
+        float min, range;
+    };
+    Arena::ScratchVector<Term> terms;
+
+    /** the schedules in the pool. Schedule i is at pool[i * numCourses ... (i + 1) * numCourses) */
+    Arena::ScratchVector<uint16_t> pool;
+    Arena::ScratchVector<float> poolCosts;
+    /** the index of the generated schedule of each schedule in the pool, or -1 if it is found by the search */
+    Arena::ScratchVector<int> poolOrigins;
+    int capacity = 0;
+    /** (cost, index) of the schedules in the pool, with the worst one at the top */
+    priority_queue<pair<float, int>, Arena::ScratchVector<pair<float, int>>> worst;
+    /**
+     * hashes of the schedules in the pool. A schedule outside of the pool is never offered again with a cost lower than
+     * the worst one in the pool, because the worst cost only decreases, so they are enough to keep the pool distinct
+     */
+    unordered_set<uint64_t, hash<uint64_t>, equal_to<uint64_t>, Arena::ScratchAllocator<uint64_t>> members;
+
+    /** the classes of a day, used by evaluate */
+    Arena::ScratchVector<uint16_t> starts, ends, rooms;
+    default_random_engine eng;
+
+    LocalSearch(const int* _sectionLens, const ConflictChecker& _checker, const uint16_t* _timeArray)
+        : sectionLens(_sectionLens), checker(_checker), timeArray(_timeArray), content(_timeArray + _sectionLens[numCourses] * 8) {
+        int rank = 0;
+        for (auto& option : sortOptions) {
+            // the random sort has no objective
+            if (!option.enabled || option.idx >= NUM_METRICS) continue;
+            float weight = sortMode == SortMode::combined ? option.weight : pow(1e-3f, rank++);
+            terms.push_back({option.idx, weight, option.reverse, 0.0f, 1.0f});
+        }
+    }
+
+    static uint64_t hashOf(const uint16_t* schedule) {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (int i = 0; i < numCourses; i++) hash = (hash ^ schedule[i]) * 0x100000001B3ull;
+        return hash;
+    }
+
+    /**
+     * compute the values of the sort functions (in the order of sortFunctions) of a schedule
+     */
+    void evaluate(const uint16_t* __restrict__ schedule, float* __restrict__ values) {
+        int sum[NUM_PATTERN_METRICS] = {}, sumSq = 0;
+        for (int j = 0; j < 7; j++) {
+            starts.clear();
+            ends.clear();
+            rooms.clear();
+            for (int k = 0; k < numCourses; k++) {
+                int _off = schedule[k] * 8 + j;
+                // insertion sort by the start time, after the classes starting at the same time
+                for (int n = timeArray[_off], e2 = timeArray[_off + 1]; n < e2; n += 3) {
+                    int p = starts.size();
+                    while (p > 0 && starts[p - 1] > content[n]) p--;
+                    starts.insert(starts.begin() + p, content[n]);
+                    ends.insert(ends.begin() + p, content[n + 1]);
+                    rooms.insert(rooms.begin() + p, content[n + 2]);
+                }
+            }
+            int metrics[NUM_PATTERN_METRICS] = {};
+            dayMetrics(starts.data(), ends.data(), starts.size(), metrics);
+            if (timeMatrix != NULL) metrics[distanceMetric] = dayDistance(starts.data(), ends.data(), rooms.data(), starts.size());
+            for (int m = 0; m < NUM_PATTERN_METRICS; m++) sum[m] += metrics[m];
+            sumSq += metrics[classTimeMetric] * metrics[classTimeMetric];
+        }
+        float mean = sum[classTimeMetric] / 5.0f;
+        values[0] = sum[distanceMetric];
+        values[1] = sumSq / 5.0f - mean * mean;
+        values[2] = sum[gapsMetric];
+        values[3] = sum[lunchMetric];
+        values[4] = sum[earlyMetric];
+        int diff = numCourses;
+        for (int k = 0; k < numCourses && refSchedule != NULL; k++) diff -= (refSchedule[k] == schedule[k]);
+        values[5] = refSchedule != NULL ? diff : 0;
+    }
+
+    float costOf(const float* values) const {
+        float cost = 0;
+        for (auto& term : terms) {
+            float val = (term.reverse ? term.min + term.range - values[term.func] : values[term.func] - term.min) / term.range;
+            cost += term.weight * val * val;
+        }
+        return cost;
+    }
+
+    float costOf(const uint16_t* schedule) {
+        float values[NUM_METRICS];
+        evaluate(schedule, values);
+        return costOf(values);
+    }
+
+    /**
+     * add a schedule to the pool if it is not there yet and is better than the worst one when the pool is full
+     * @param origin the index of the generated schedule, or -1 if it is not a generated one
+     * @returns whether the schedule is added
+     */
+    bool offer(const uint16_t* schedule, float cost, int origin = -1) {
+        // the moves do not track the number of optional courses taken
+        if (!withinOptionalLimits(sectionLens, schedule)) return false;
+        uint64_t hash = hashOf(schedule);
+        if (members.count(hash)) return false;
+        int slot = poolCosts.size();
+        if (slot < capacity) {
+            pool.resize((slot + 1) * numCourses);
+            poolCosts.push_back(cost);
+            poolOrigins.push_back(origin);
+        } else {
+            if (cost >= worst.top().first) return false;
+            slot = worst.top().second;
+            worst.pop();
+            members.erase(hashOf(pool.data() + slot * numCourses));
+            poolCosts[slot] = cost;
+            poolOrigins[slot] = origin;
+        }
+        memcpy(pool.data() + slot * numCourses, schedule, numCourses * sizeof(uint16_t));
+        members.insert(hash);
+        worst.push({cost, slot});
+        return true;
+    }
+
+    /**
+     * draw a valid schedule by a depth first search that tries the sections of each course in random order
+     * @returns false if no schedule is found within a limited number of steps
+     */
+    bool randomSchedule(uint16_t* __restrict__ out) {
+        Arena::ScratchVector<uint16_t> order;
+        // order[sectionLens[i] ... sectionLens[i + 1]) is a permutation of the sections of course i
+        for (int i = 0; i < sectionLens[numCourses]; i++) order.push_back(i);
+        for (int i = 0; i < numCourses; i++) shuffle(order.begin() + sectionLens[i], order.begin() + sectionLens[i + 1], eng);
+        Arena::ScratchVector<int> next(numCourses + 1);
+        int courseIdx = 0, steps = 0;
+        next[0] = sectionLens[0];
+        while (courseIdx < numCourses) {
+            if (++steps > 100000) return false;
+            if (next[courseIdx] >= sectionLens[courseIdx + 1]) {
+                if (--courseIdx < 0) return false;
+                continue;
+            }
+            int sec = order[next[courseIdx]++];
+            if (prunedBy[sec] >= 0) continue;
+            bool conflict = false;
+            for (int i = 0; i < courseIdx && !conflict; i++) conflict = checker.isConflict(sec, out[i]);
+            if (conflict) continue;
+            out[courseIdx++] = sec;
+            next[courseIdx] = sectionLens[courseIdx];
+        }
+        return true;
+    }
+
+    /**
+     * @param numSeeds number of schedules generated. The best of them are the starting points of the search
+     * @param budget the time budget in milliseconds
+     * @returns the number of schedules written, which is numSeeds
+     */
+    int run(int numSeeds, double budget) {
+        TRACE_SPAN("ScheduleGenerator::localSearch");
+        auto deadline = chrono::steady_clock::now() + chrono::duration<double, milli>(budget);
+        capacity = std::min(numSeeds, POOL_SIZE);
+
+        // estimate the range of each sort function from evenly spaced seeds and some random schedules
+        int numSamples = std::min(numSeeds, NUM_RANDOM);
+        Arena::ScratchVector<float> values((numSamples + NUM_RANDOM) * NUM_METRICS);
+        Arena::ScratchVector<uint16_t> randoms(NUM_RANDOM * numCourses);
+        int numRandom = 0;
+        for (int i = 0; i < numSamples; i++) evaluate(scheduleAt((int64_t)i * numSeeds / numSamples), values.data() + i * NUM_METRICS);
+        for (int i = 0; i < NUM_RANDOM; i++) {
+            auto* schedule = randoms.data() + numRandom * numCourses;
+            if (randomSchedule(schedule)) evaluate(schedule, values.data() + (numSamples + numRandom++) * NUM_METRICS);
+        }
+        float totalWeight = 0;
+        for (auto& term : terms) {
+            float min = numeric_limits<float>::infinity(), max = -min;
+            for (int i = 0; i < numSamples + numRandom; i++) {
+                min = std::min(min, values[i * NUM_METRICS + term.func]);
+                max = std::max(max, values[i * NUM_METRICS + term.func]);
+            }
+            term.min = min;
+            term.range = max > min ? max - min : 1.0f;
+            totalWeight += term.weight;
+        }
+        // the pool starts with the best seeds
+        for (int i = 0; i < numSeeds; i++) {
+            const auto* schedule = scheduleAt(i);
+            offer(schedule, costOf(schedule), i);
+        }
+        for (int i = 0; i < numRandom; i++) offer(randoms.data() + i * numCourses, costOf(values.data() + (numSamples + i) * NUM_METRICS));
+
+        Arena::ScratchVector<uint16_t> cur(pool.begin(), pool.begin() + numCourses), candidate(numCourses), bestCandidate(numCourses);
+        float curCost = poolCosts[0];
+        // the candidate sections of each freed course
+        Arena::ScratchVector<uint16_t> choices[3];
+        Arena::ScratchVector<int> courses(numCourses), pos(3);
+        for (int i = 0; i < numCourses; i++) courses[i] = i;
+        uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        int stale = 0, numSteps = 0;
+        double remaining;
+        while ((remaining = chrono::duration<double, milli>(deadline - chrono::steady_clock::now()).count()) > 0) {
+            numSteps++;
+            float temperature = 0.05f * totalWeight * remaining / budget;
+            int k = std::min(numCourses, 2 + (int)(eng() % 2));
+            for (int i = 0; i < k; i++) swap(courses[i], courses[i + eng() % (numCourses - i)]);
+
+            // the sections of the freed courses that do not conflict with the fixed courses
+            for (int i = 0; i < k; i++) {
+                int c = courses[i];
+                choices[i].clear();
+                for (int sec = sectionLens[c]; sec < sectionLens[c + 1]; sec++) {
+                    if (prunedBy[sec] >= 0) continue;
+                    bool conflict = false;
+                    for (int j = k; j < numCourses && !conflict; j++) conflict = checker.isConflict(sec, cur[courses[j]]);
+                    if (!conflict) choices[i].push_back(sec);
+                }
+                shuffle(choices[i].begin(), choices[i].end(), eng);
+            }
+            if (any_of(choices, choices + k, [](const Arena::ScratchVector<uint16_t>& c) { return c.empty(); })) continue;
+
+            // enumerate the combinations of the freed courses like an odometer
+            float bestCost = numeric_limits<float>::infinity();
+            bool improved = false;
+            int evaluated = 0;
+            memcpy(candidate.data(), cur.data(), numCourses * sizeof(uint16_t));
+            fill(pos.begin(), pos.end(), 0);
+            while (evaluated < MAX_NEIGHBOURS) {
+                bool valid = true;
+                for (int i = 0; i < k && valid; i++) {
+                    candidate[courses[i]] = choices[i][pos[i]];
+                    for (int j = 0; j < i && valid; j++) valid = !checker.isConflict(candidate[courses[i]], candidate[courses[j]]);
+                }
+                if (valid && memcmp(candidate.data(), cur.data(), numCourses * sizeof(uint16_t)) != 0) {
+                    evaluated++;
+                    float cost = costOf(candidate.data());
+                    improved |= offer(candidate.data(), cost);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestCandidate = candidate;
+                    }
+                }
+                int i = 0;
+                for (; i < k && ++pos[i] == (int)choices[i].size(); i++) pos[i] = 0;
+                if (i == k) break;
+            }
+            if (bestCost < numeric_limits<float>::infinity() &&
+                (bestCost < curCost || uniform(eng) < exp((curCost - bestCost) / temperature))) {
+                cur = bestCandidate;
+                curCost = bestCost;
+            }
+            stale = improved ? 0 : stale + 1;
+            if (stale >= RESTART_STEPS) {
+                // restart from a random schedule or a random member of the pool
+                if (eng() % 2 == 0 && randomSchedule(cur.data())) {
+                    curCost = costOf(cur.data());
+                    offer(cur.data(), curCost);
+                } else {
+                    int i = eng() % poolCosts.size();
+                    memcpy(cur.data(), pool.data() + i * numCourses, numCourses * sizeof(uint16_t));
+                    curCost = poolCosts[i];
+                }
+                stale = 0;
+            }
+        }
+        TRACE_COUNTER("ScheduleGenerator::localSearchSteps", numSteps);
+
+        // the generated schedules outside of the pool in front are moved to the places of the seeds in the pool behind,
+        // which are kept by the pool. The remaining ones are replaced by the new schedules in the pool
+        int size = poolCosts.size();
+        Arena::ScratchVector<uint8_t> inPool(size, 0);
+        for (int origin : poolOrigins) {
+            if (origin >= 0 && origin < size) inPool[origin] = 1;
+        }
+        for (int i = 0, src = 0; i < size; i++) {
+            if (poolOrigins[i] < size) continue;
+            while (src < size && inPool[src]) src++;
+            if (src == size) break;
+            memcpy(scheduleAt(poolOrigins[i]), scheduleAt(src++), numCourses * sizeof(uint16_t));
+        }
+        // write the pool from the best to the worst
+        Arena::ScratchVector<int> order(size);
+        for (int i = 0; i < size; i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return poolCosts[a] < poolCosts[b]; });
+        for (int i = 0; i < size; i++) memcpy(scheduleAt(i), pool.data() + order[i] * numCourses, numCourses * sizeof(uint16_t));
+        return numSeeds;
+    }
+};
+
+#ifndef _TEST
+/** maximum number of schedules produced by solveMILP, each of which takes a solve of the model */
+constexpr int MILP_MAX_SOLUTIONS = 100;
+/** total time limit of all solves of the model in milliseconds */
+constexpr int MILP_TIME_LIMIT = 3000;
+
+/**
+ * find the schedules with the least total sectionCosts by 0/1 integer programming, used when the subproblem memo is not available.
+ *
+ * There is one binary variable for each section, and exactly one section of each course is chosen.
+ * Two conflicting sections cannot both be chosen: the sections with exact occupancy bitmaps that occupy the same time slot
+ * form a clique, which is covered by a single constraint, and the other conflicts are added pair by pair.
+ * After each solution is found, a no-good cut that excludes it is added, so the next solve produces the next best schedule.
+ * The solves stop when MILP_TIME_LIMIT is used up, so only the schedules found until then are produced
+ * @returns the number of schedules written, or -1 on memory allocation failure
+ */
+int solveMILP(const int* __restrict__ sectionLens, const ConflictChecker& checker, int maxNumSchedules) {
+    TRACE_SPAN("ScheduleGenerator::solveMILP");
+    int numSections = sectionLens[numCourses];
+    auto* courseOf = Arena::allocArray<int>(numSections);
+    for (int i = 0; i < numCourses; i++) {
+        for (int s = sectionLens[i]; s < sectionLens[i + 1]; s++) courseOf[s] = i;
+    }
+
+    glp_prob* lp = glp_create_prob();
+    glp_set_obj_dir(lp, GLP_MIN);
+    // column s + 1 is the variable of section s
+    glp_add_cols(lp, numSections);
+    for (int s = 0; s < numSections; s++) {
+        glp_set_col_kind(lp, s + 1, GLP_BV);
+        // the sections removed by pruneSections are never chosen
+        if (prunedBy[s] >= 0) glp_set_col_bnds(lp, s + 1, GLP_FX, 0.0, 0.0);
+        glp_set_obj_coef(lp, s + 1, sectionCosts[s]);
+    }
+
+    // index 0 is not used by glpk
+    Arena::ScratchVector<int> ia(1), ja(1);
+    Arena::ScratchVector<double> ar(1);
+    int row = 0;
+    auto addConstraint = [&](int auxVar, int structVar, double coeff) {
+        ia.push_back(auxVar);
+        ja.push_back(structVar);
+        ar.push_back(coeff);
+    };
+    // exactly one section of each course
+    glp_add_rows(lp, numCourses);
+    for (int i = 0; i < numCourses; i++) {
+        ++row;
+        for (int s = sectionLens[i]; s < sectionLens[i + 1]; s++) addConstraint(row, s + 1, 1.0);
+        glp_set_row_bnds(lp, row, GLP_FX, 1.0, 1.0);
+    }
+
+    // the number of optional courses taken, i.e. the number of their skip sections not chosen
+    if (optionalCourses != NULL) {
+        int numOptional = 0;
+        glp_add_rows(lp, 1);
+        ++row;
+        for (int i = 0; i < numCourses; i++) {
+            if (!optionalCourses[i]) continue;
+            numOptional++;
+            addConstraint(row, sectionLens[i + 1], 1.0);
+        }
+        double lo = numOptional - std::min(maxOptional, numOptional), hi = numOptional - std::max(minOptional, 0);
+        glp_set_row_bnds(lp, row, lo == hi ? GLP_FX : GLP_DB, lo, hi);
+    }
+    // the cliques of the sections occupying each time slot. Adjacent slots are often occupied by the same sections
+    Arena::ScratchVector<int> clique, lastClique;
+    if (checker.occupancy != NULL) {
+        for (int bit = 0; bit < 7 * SLOTS_PER_DAY; bit++) {
+            clique.clear();
+            for (int s = 0; s < numSections; s++) {
+                const auto& occ = checker.occupancy[s];
+                if (prunedBy[s] < 0 && occ.exact && ((occ.bits[bit >> 6] >> (bit & 63)) & 1)) clique.push_back(s);
+            }
+            // the constraint is implied by the one of a course if all sections are from the same course
+            if (clique.size() < 2 || courseOf[clique.front()] == courseOf[clique.back()] || clique == lastClique) continue;
+            lastClique = clique;
+            glp_add_rows(lp, 1);
+            ++row;
+            for (int s : clique) addConstraint(row, s + 1, 1.0);
+            glp_set_row_bnds(lp, row, GLP_UP, 0.0, 1.0);
+        }
+    }
+    // the conflicts not covered by the cliques
+    for (int a = 0; a < numSections; a++) {
+        if (prunedBy[a] >= 0) continue;
+        bool exactA = checker.occupancy != NULL && checker.occupancy[a].exact;
+        for (int b = sectionLens[courseOf[a] + 1]; b < numSections; b++) {
+            if (prunedBy[b] >= 0 || (exactA && checker.occupancy[b].exact) || !checker.isConflict(a, b)) continue;
+            glp_add_rows(lp, 1);
+            ++row;
+            addConstraint(row, a + 1, 1.0);
+            addConstraint(row, b + 1, 1.0);
+            glp_set_row_bnds(lp, row, GLP_UP, 0.0, 1.0);
+        }
+    }
+    glp_load_matrix(lp, ia.size() - 1, ia.data(), ja.data(), ar.data());
+
+    glp_iocp parm;
+    glp_init_iocp(&parm);
+    parm.presolve = GLP_ON;
+    parm.msg_lev = GLP_MSG_ERR;
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(MILP_TIME_LIMIT);
+
+    int numGenerated = 0;
+    // indices (1-based) and coefficients of a no-good cut
+    Arena::ScratchVector<int> ind(numCourses + 1);
+    Arena::ScratchVector<double> val(numCourses + 1, 1.0);
+    for (int limit = std::min(maxNumSchedules, MILP_MAX_SOLUTIONS); numGenerated < limit; numGenerated++) {
+        // each solve is limited to the time left
+        auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (remaining <= 0) break;
+        parm.tm_lim = remaining;
+        if (glp_intopt(lp, &parm) != 0) break;
+        int status = glp_mip_status(lp);
+        if (status != GLP_OPT && status != GLP_FEAS) break;
+
+        auto* schedule = reserveSchedule(numGenerated);
+        if (schedule == NULL) {
+            glp_delete_prob(lp);
+            return -1;
+        }
+        for (int i = 0; i < numCourses; i++) {
+            for (int s = sectionLens[i]; s < sectionLens[i + 1]; s++) {
+                if (glp_mip_col_val(lp, s + 1) > 0.5) {
+                    schedule[i] = s;
+                    break;
+                }
+            }
+            ind[i + 1] = schedule[i] + 1;
+        }
+        // at most numCourses - 1 sections of this schedule can be chosen again
+        glp_add_rows(lp, 1);
+        glp_set_mat_row(lp, ++row, numCourses, ind.data(), val.data());
+        glp_set_row_bnds(lp, row, GLP_UP, 0.0, numCourses - 1);
+    }
+    glp_delete_prob(lp);
+    TRACE_COUNTER("ScheduleGenerator::milpRows", row);
+    return numGenerated;
+}
+#endif
 
 /**
- * sort the array of schedules according to their quality coefficients which will be computed by `computeCoeff`
+ * @param _numCourses number of courses
+ * @param sectionLens a prefix array that stores the number of sections in each course
+ * sectionLens[i] is the total number of sections in courses 0 to i - 1 inclusive
+ * sectionLens[numCourses] is the total number of sections 
+ * @param conflictCache the conflict cache matrix which caches the conflict between each pair of sections.
+ * To check whether section i conflicts with section j: conflictCache[i * numSections + j] (or conflictCache[j * numSections + i])
+ * Can be NULL, in which case the conflicts are checked using the weekly occupancy bitmaps built from the timeArray and dates
+ * @param timeArray the compact time arrays of all sections: 8 offsets of each section, followed by the (start, end, room) triples
+ * @param dates [start, end] date (in days) of each section. Can be NULL if all sections have the same date range
+ * @note the pointers passed in to this function should point to dynamically allocated memory. They will be freed before this function returns. 
+ * @returns the number of schedules generated. Returns -1 on memory allocation failure,
+ * in which case the previously generated schedules are discarded, and the inputs are not freed.
+ * The options set by setSectionCosts, setOptionalCourses and setSectionIds are freed in either case
  */
-void sort() {
-    // we start from the original order
-    // so that when the sort is performed repetitively, the result will be stable
-    for (int i = 0; i < count; i++)
-        indices[i] = i;
-    if (isRandom()) {
-        default_random_engine eng;
-        shuffle(indices, indices + count, eng);
-        return;
+int generate(const int _numCourses, int maxNumSchedules, const int* __restrict__ sectionLens, const uint8_t* __restrict__ conflictCache, const uint16_t* __restrict__ timeArray, const int* __restrict__ dates) {
+    TRACE_SPAN("ScheduleGenerator::generate");
+    Arena::Scope scope;
+    numCourses = _numCourses;
+    // the chunks have a fixed layout, so they cannot be reused if the number of courses changes
+    if (numCourses != chunkWidth) {
+        freeScheduleChunks(0);
+        chunkWidth = numCourses;
+        count = 0;
+    }
+    if (sectionLens[numCourses] > prunedLen) {
+        auto* newMem = (int16_t*)realloc(prunedBy, sectionLens[numCourses] * sizeof(int16_t));
+        if (newMem == NULL) {
+            resetGenerationOptions();
+            return -1;
+        }
+        prunedBy = newMem;
+        prunedLen = sectionLens[numCourses];
     }
-    static SortOption enabledOptions[NUM_SORT_FUNCS];
+    // no section is pruned if the generation ends before the preprocessing
+    for (int i = 0; i < sectionLens[numCourses]; i++) prunedBy[i] = -1;
 
-    int enabled = 0;
-    int lastIdx = -1;
-    for (int i = 0; i < 7; i++) {
-        auto& option = sortOptions[i];
-        if (option.enabled) {
-            enabledOptions[enabled++] = option;
-            lastIdx = option.idx;
+    /** current course index */
+    int courseIdx = 0;
+    /** the index of the current section */
+    int sectionIdx = 0;
+    /** number of schedules generated so far */
+    int numGenerated = 0;
+    /** pointer to the current schedule, i.e. the schedule at index numGenerated */
+    auto* curSchedule = reserveSchedule(0);
+    if (curSchedule == NULL) {
+        resetGenerationOptions();
+        return -1;
+    }
+    int numSections = sectionLens[numCourses];
+    ConflictChecker checker(numSections, conflictCache, timeArray, dates, catalogIndex.ids.empty() ? NULL : sectionIds);
+    /**
+     * occupied[i] is the union of the occupancy bitmaps of curSchedule[0 ... i - 1],
+     * and numInexact[i] is the number of sections among them whose bitmaps are not exact
+     */
+    auto* occupied = Arena::allocArray<Occupancy>(numCourses + 1);
+    auto* numInexact = Arena::allocArray<int>(numCourses + 1);
+    memset(occupied[0].bits, 0, sizeof(occupied[0].bits));
+    numInexact[0] = 0;
+    /**
+     * optionalLeft[i] is the number of optional courses among courses i ... numCourses - 1,
+     * and numTaken[i] is the number of optional courses taken by curSchedule[0 ... i - 1]
+     */
+    auto* optionalLeft = Arena::allocArray<int>(numCourses + 1);
+    auto* numTaken = Arena::allocArray<int>(numCourses + 1);
+    optionalLeft[numCourses] = numTaken[0] = 0;
+    for (int i = numCourses - 1; i >= 0; i--) optionalLeft[i] = optionalLeft[i + 1] + (optionalCourses != NULL && optionalCourses[i]);
+    /** whether the limits on the number of optional courses taken exclude some combinations of the courses */
+    const bool limited = optionalLeft[0] > 0 && (minOptional > 0 || maxOptional < optionalLeft[0]);
+    SubproblemMemo* memo = NULL;
+    /** whether sectionCounts are counted by the memo instead of from the schedules generated */
+    bool countsExact = false;
+    totalCount = 0;
+    if (optionalCourses != NULL && (minOptional > maxOptional || minOptional > optionalLeft[0])) goto end;
+    // shrink the domains before the search. If some domain becomes empty, there is no need to search at all
+    if (!pruneSections(sectionLens, checker)) goto end;
+    totalCount = -1;
+    // the subproblems do not track the number of optional courses taken
+    if (conflictCache == NULL && checker.allExact && numCourses > 1 && !limited) {
+        memo = new (Arena::allocArray<SubproblemMemo>(1)) SubproblemMemo(sectionLens, checker);
+        memo->sectionCosts = sectionCosts;
+        totalCount = memo->solve(0, occupied[0]).count;
+        TRACE_COUNTER("ScheduleGenerator::memoSize", memo->size);
+        if (memo->full) {
+            memo->~SubproblemMemo();
+            memo = NULL;
+            totalCount = -1;
+        } else if (totalCount == 0.0) {
+            goto end;
+        } else if (sectionCosts != NULL) {
+            numGenerated = memo->enumerateBest(maxNumSchedules);
+            if (numGenerated < 0) goto fail;
+            goto end;
+        } else if (sampling && totalCount > maxNumSchedules) {
+            // take one schedule from each of the maxNumSchedules equal-sized strata of the ranks
+            double stride = totalCount / maxNumSchedules;
+            default_random_engine eng;
+            uniform_real_distribution<double> dist(0.0, 1.0);
+            for (; numGenerated < maxNumSchedules; numGenerated++) {
+                if ((curSchedule = reserveSchedule(numGenerated)) == NULL) goto fail;
+                double lo = floor(numGenerated * stride), hi = floor((numGenerated + 1) * stride);
+                memo->unrank(std::min(lo + floor(dist(eng) * (hi - lo)), totalCount - 1), curSchedule);
+            }
+            goto end;
         }
     }
-    if (enabled == 0) return;
-    computeCoeff(enabled, lastIdx);
+    // the schedules with the least costs cannot be enumerated in order without the memo. They are found by the solver
+    // in the optimal mode only. Otherwise, or if GLPK is not loaded yet, the schedules are enumerated as usual
+    // and ranked by the sort options instead
+#ifndef _TEST
+    if (sectionCosts != NULL && optimalMode && memo == NULL && Solver::available) {
+        numGenerated = solveMILP(sectionLens, checker, maxNumSchedules);
+        if (numGenerated < 0) goto fail;
+        goto end;
+    }
+#endif
+    while (true) {
+        if (courseIdx >= numCourses) {  // we have finished building the current schedule
+            // copy the current schedule to next schedule
+            if (++numGenerated >= maxNumSchedules) goto end;
+            auto* nextSchedule = reserveSchedule(numGenerated);
+            if (nextSchedule == NULL) goto fail;
+            memcpy(nextSchedule, curSchedule, numCourses * sizeof(uint16_t));
 
-    if (sortMode == SortMode::combined || enabled == 1) {
+            curSchedule = nextSchedule;
+            sectionIdx = curSchedule[--courseIdx] + 1;
+        }
+    next:;
         /**
-         * The comparator function used:
-         *
-         * if only one option is enabled, the sort direction depends on the `reversed` property of it
-         *
-         * if multiple sort options are enabled and the sort mode is combined, the `computeCoeff` method
-         * will take care of the sort direction of each function, so we sort in ascending order anyway
+         * when all possibilities in on class have exhausted, explore the next possibility in the previous class
+         * reset choices of the later classes to 0
          */
-        auto cmpFunc =
-            enabledOptions[0].reverse && enabled == 1
-                ? [](int a, int b) { return coeffs[b] < coeffs[a]; }   // descending
-                : [](int a, int b) { return coeffs[a] < coeffs[b]; };  // ascending
-        if (count > 1000) {
-            std::partial_sort(indices, indices + 1000, indices + count, cmpFunc);
-        } else {
-            std::sort(indices, indices + count, cmpFunc);
+        while (sectionIdx >= sectionLens[courseIdx + 1]) {
+            // return to the previous class
+            // if all possibilities are exhausted, break out the loop
+            if (--courseIdx < 0) goto end;
+
+            // explore the next possibility
+            sectionIdx = curSchedule[courseIdx] + 1;
+            for (int i = courseIdx + 1; i < numCourses; i++) curSchedule[i] = 0;
         }
-    } else {
-        struct {
-            float rev;
-            float* coeffs;
-        } data[enabled];
-        // if option[i] is reverse, ifReverse[i] will be -1 * weight
-        // cached array of coefficients for each enabled sort function
-        for (int i = 0; i < enabled; i++) {
-            data[i].rev = enabledOptions[i].reverse ? -1.0f : 1.0f;
-            data[i].coeffs = sortCoeffCache[enabledOptions[i].idx].coeffs;
+
+        // skip the sections removed by pruneSections
+        if (prunedBy[sectionIdx] >= 0) {
+            ++sectionIdx;
+            goto next;
+        }
+        // check conflict between the newly chosen section and the sections already in the schedule
+        if (conflictCache != NULL) {
+            int temp = sectionIdx * numSections;
+            for (int i = 0; i < courseIdx; i++) {
+                if (conflictCache[temp + curSchedule[i]]) {
+                    // if conflict, increment the section index
+                    ++sectionIdx;
+                    goto next;
+                }
+            }
+        } else if (checker.intersects(sectionIdx, occupied[courseIdx])) {
+            // the overlap is a conflict for sure if all bitmaps involved are exact. Otherwise, check each chosen section
+            bool conflict = checker.occupancy[sectionIdx].exact && numInexact[courseIdx] == 0;
+            for (int i = 0; i < courseIdx && !conflict; i++) conflict = checker.isConflict(sectionIdx, curSchedule[i]);
+            if (conflict) {
+                ++sectionIdx;
+                goto next;
+            }
         }
-        auto func = [enabled, &data](int a, int b) {
-            float r = 0;
-            for (int i = 0; i < enabled; i++) {
-                // calculate the difference in coefficients
-                r = data[i].rev * (data[i].coeffs[a] - data[i].coeffs[b]);
 
-                // if non-zero, returns this coefficient
-                if (r != 0.0) return r < 0;
+        // the number of optional courses taken must be able to end up within the limits
+        if (limited) {
+            int taken = numTaken[courseIdx] + (optionalCourses[courseIdx] && isTaken(sectionLens, courseIdx, sectionIdx));
+            if (taken > maxOptional) {
+                // no other section can be taken either, so only the skip section is left
+                sectionIdx = sectionLens[courseIdx + 1] - 1;
+                goto next;
+            }
+            if (taken + optionalLeft[courseIdx + 1] < minOptional) {
+                ++sectionIdx;
+                goto next;
+            }
+            numTaken[courseIdx + 1] = taken;
+        }
 
-                // otherwise, fallback to the next sort option
+        // if the section does not conflict with any previously chosen sections,
+        // record the section and go to the next class,
+        if (conflictCache == NULL) {
+            const auto& occ = checker.occupancy[sectionIdx];
+            auto& cur = occupied[courseIdx + 1];
+            cur = occupied[courseIdx];
+            for (int w = occ.lo; w < occ.hi; w++) cur.bits[w] |= occ.bits[w];
+            numInexact[courseIdx + 1] = numInexact[courseIdx] + !occ.exact;
+            // the remaining courses cannot be completed
+            if (memo != NULL && memo->isDeadEnd(courseIdx + 1, cur)) {
+                ++sectionIdx;
+                goto next;
             }
-            return r < 0;
-        };
-        if (count > 1000) {
-            std::partial_sort(indices, indices + 1000, indices + count, func);
-        } else {
-            std::sort(indices, indices + count, func);
         }
+        curSchedule[courseIdx++] = sectionIdx;
+        // set choice num to be the first section of the next class
+        sectionIdx = sectionLens[courseIdx];
+    }
+end:;
+    sectionCounts.assign(numSections, 0.0);
+    if (memo != NULL) {
+        memo->countSections(sectionCounts.data());
+        memo->~SubproblemMemo();
+        countsExact = true;
+    }
+    memo = NULL;
+    // there are more schedules than can be kept: improve the ones generated by local search
+    if (searchBudget > 0 && numGenerated >= maxNumSchedules && totalCount != numGenerated && sectionCosts == NULL) {
+        LocalSearch search(sectionLens, checker, timeArray);
+        if (!search.terms.empty()) numGenerated = search.run(numGenerated, searchBudget);
+    }
+    count = numGenerated;
+    // without the memo, the counts are over the schedules generated, which are all the valid ones unless truncated
+    if (!countsExact) {
+        for (int i = 0; i < count; i++) {
+            const auto* schedule = scheduleAt(i);
+            for (int j = 0; j < numCourses; j++) sectionCounts[schedule[j]] += 1.0;
+        }
+    }
+    resetView();
+    sectionIndexValid = false;
+    // the enumeration is exhaustive if it is not truncated
+    if (totalCount < 0 && count < maxNumSchedules) totalCount = count;
+    // release the chunks not used by this generation
+    freeScheduleChunks((count + CHUNK_SIZE - 1) >> CHUNK_SHIFT);
+    TRACE_COUNTER("ScheduleGenerator::count", count);
+
+    // handle reallocation of memory
+    // indices, coeffs and 7 pattern ids for each schedule
+    evalLen = (uint32_t)(count) * (4 + 4 + 7 * 4);
+    if (evalLen > memSize) {
+        void* newMem = realloc(evalMem, evalLen);
+        // count and the view are already set to this generation, so they are reset to not refer to the old buffers
+        if (newMem == NULL) goto fail;
+        evalMem = newMem;
+        memSize = evalLen;
+        MemoryStats::set(MemoryStats::evalMem, memSize);
+    }
+    // the layout depends on count, so always reassign even if no reallocation happened
+    assignEvalMem();
+
+    addToEval(timeArray, sectionLens);
+
+// cleanup
+#ifndef _TEST
+    free((void*)sectionLens);
+    free((void*)conflictCache);
+    free((void*)timeArray);
+    free((void*)dates);
+#endif
+    resetGenerationOptions();
+    for (int i = 0; i < NUM_SORT_FUNCS; i++) freeCoeffCache(i);
+    return count;
+fail:
+    // the previous schedules are partially overwritten
+    if (memo != NULL) memo->~SubproblemMemo();
+    count = 0;
+    totalCount = -1;
+    resetView();
+    sectionIndexValid = false;
+    freeScheduleChunks(0);
+    for (int i = 0; i < NUM_SORT_FUNCS; i++) freeCoeffCache(i);
+    resetGenerationOptions();
+    return -1;
+}
+
+/**
+ * sort the array of schedules according to their quality coefficients which will be computed by `sortJob`
+ */
+void sort() {
+    TRACE_SPAN("ScheduleGenerator::sort");
+    if (sortJob.start() > 0) sortJob.step(0);
+}
+
+/**
+ * rank a stratified random sample of the view and place it at the front of the view,
+ * so that an approximate top page is available immediately. In the combined mode, the functions are normalized
+ * by their range in the sample. Then an exact sort is started, which is continued by sortStep
+ * @param numSamples the number of schedules sampled. One schedule is drawn from each of numSamples
+ * consecutive strata of the view, so that the sample spreads over the order of the DFS
+ * @returns the number of schedules ranked at the front of the view, or -1 if the view is already sorted exactly
+ */
+int sortPreview(int numSamples) {
+    TRACE_SPAN("ScheduleGenerator::sortPreview");
+    int enabled = sortJob.start();
+    if (enabled == 0) return -1;
+    if (viewCount <= numSamples) {
+        sortJob.step(0);
+        return -1;
+    }
+    Arena::Scope scope;
+    resetIndices();
+    const auto* options = sortJob.options;
+    Arena::ScratchVector<int> positions(numSamples), order(numSamples);
+    Arena::ScratchVector<float> values(numSamples * enabled), keys(numSamples, 0.0f);
+    default_random_engine eng;
+    for (int k = 0; k < numSamples; k++) {
+        int lo = (int)((int64_t)k * viewCount / numSamples), hi = (int)((int64_t)(k + 1) * viewCount / numSamples);
+        positions[k] = uniform_int_distribution<int>(lo, hi - 1)(eng);
+        order[k] = k;
+        int id = indices[positions[k]];
+        for (int j = 0; j < enabled; j++) {
+            int idx = options[j].idx;
+            const auto* cached = sortCoeffCache[idx].coeffs;
+            values[k * enabled + j] = cached != NULL ? cached[id] : sortFunctions[idx](id);
+        }
+    }
+
+    if (enabled == 1) {
+        for (int k = 0; k < numSamples; k++) keys[k] = options[0].reverse ? -values[k] : values[k];
+    } else if (sortMode == SortMode::combined) {
+        // the same combination as combineCoeff, with the range estimated from the sample
+        for (int j = 0; j < enabled; j++) {
+            float max = -std::numeric_limits<float>::infinity(), min = std::numeric_limits<float>::infinity();
+            for (int k = 0; k < numSamples; k++) {
+                float val = values[k * enabled + j];
+                if (val > max) max = val;
+                if (val < min) min = val;
+            }
+            float range = max - min;
+            if (range == 0.0) continue;
+            float normalizeRatio = 1 / range, weight = options[j].weight;
+            for (int k = 0; k < numSamples; k++) {
+                float val = values[k * enabled + j];
+                val = (options[j].reverse ? max - val : val - min) * normalizeRatio;
+                keys[k] += weight * val * val;
+            }
+        }
+    }
+    if (enabled == 1 || sortMode == SortMode::combined) {
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+    } else {
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            for (int j = 0; j < enabled; j++) {
+                float r = values[a * enabled + j] - values[b * enabled + j];
+                if (options[j].reverse) r = -r;
+                if (r != 0.0) return r < 0;
+            }
+            return false;
+        });
+    }
+
+    // move the other schedules to the back of the view in their original order, then put the ranked sample in front
+    Arena::ScratchVector<int> ranked(numSamples);
+    for (int k = 0; k < numSamples; k++) ranked[k] = indices[positions[order[k]]];
+    int dst = viewCount;
+    for (int i = viewCount - 1, k = numSamples - 1; i >= 0; i--) {
+        if (k >= 0 && positions[k] == i) {
+            k--;
+            continue;
+        }
+        indices[--dst] = indices[i];
     }
+    memcpy(indices, ranked.data(), numSamples * sizeof(int));
+    return numSamples;
+}
+
+/**
+ * continue the exact sort started by sortPreview
+ * @param budget the time budget in milliseconds
+ * @returns true if the sort is complete, in which case the view is sorted exactly.
+ * It is also true if the sort is cancelled by a new generation or sort
+ */
+bool sortStep(double budget) {
+    TRACE_SPAN("ScheduleGenerator::sortStep");
+    return sortJob.step(budget);
 }
 
 void setSortMode(int mode) {
@@ -590,15 +2590,431 @@ void setTimeMatrix(int* ptr, int sideLen) {
     if (timeMatrix != NULL) delete[] timeMatrix;
     timeMatrix = ptr;
     tmSize = sideLen;
+    patternDistanceValid = false;
+    MemoryStats::set(MemoryStats::timeMatrix, sideLen * sideLen * sizeof(int));
 }
 
+/**
+ * @returns the number of schedules in the view
+ */
 int size() {
-    return count;
+    return viewCount;
+}
+
+/**
+ * @returns the total number of valid schedules of the last generation, which can be greater than size().
+ * Returns -1 if the number is unknown
+ */
+double getTotalCount() {
+    return totalCount;
+}
+
+/**
+ * @param costs the cost of each section used by the next generation, which will produce the schedules
+ * with the least total costs in ascending order. Will be freed by generate. Pass NULL to disable
+ * @param optimal whether the optimal mode is requested
+ * @note the schedules are enumerated in order of their costs when all sections meet at times aligned to 5 minutes
+ * and have the same date range. Otherwise, in the optimal mode, the best MILP_MAX_SOLUTIONS of them are found by solveMILP,
+ * which needs the GLPK side module to be loaded (see Solver.hpp). If not, the schedules are enumerated as usual
+ */
+void setSectionCosts(float* costs, int optimal) {
+    free(sectionCosts);
+    sectionCosts = costs;
+    optimalMode = optimal;
+}
+
+/**
+ * let the next generation leave some courses out, so that a single search explores the combinations of the courses
+ * taken and their sections together
+ * @param optional optional[i] is non-zero if course i may be left out, in which case its last section must be
+ * a skip section with no meetings, which is chosen when the course is not taken. Will be freed by generate.
+ * Pass NULL if all courses are required
+ * @param minTaken the minimum number of optional courses taken
+ * @param maxTaken the maximum number of optional courses taken
+ */
+void setOptionalCourses(uint8_t* optional, int minTaken, int maxTaken) {
+    free(optionalCourses);
+    optionalCourses = optional;
+    minOptional = minTaken;
+    maxOptional = maxTaken;
+}
+
+/**
+ * @param ids the catalog id of each section of the next generation, whose bitmaps and conflicts are then
+ * taken from the catalog index if it has them. Will be freed by generate. Pass NULL to disable
+ */
+void setSectionIds(int* ids) {
+    free(sectionIds);
+    sectionIds = ids;
+}
+
+/**
+ * build the table of all sections of the catalog, replacing the current one
+ * @param numSections number of sections of the catalog
+ * @param ids the catalog id of each section. Each id must be unique
+ * @param offsets the time array of section i is times[offsets[i] ... offsets[i + 1]):
+ * 8 offsets of the days relative to the end of the offsets, followed by the (start, end, room) triples
+ * @param times the time arrays of all sections
+ * @param dates [start, end] date of each section in days
+ * @note all arrays will be freed by this function
+ */
+void buildCatalogIndex(int numSections, int* ids, uint32_t* offsets, uint16_t* times, int* dates) {
+    TRACE_SPAN("ScheduleGenerator::buildCatalogIndex");
+    MemoryStats::track(MemoryStats::catalogIndex, -(int64_t)catalogIndex.bytes());
+    auto& index = catalogIndex;
+    index.clear();
+    {
+        Arena::Scope scope;
+        auto* order = Arena::allocArray<int>(numSections);
+        for (int i = 0; i < numSections; i++) order[i] = i;
+        std::sort(order, order + numSections, [=](int a, int b) { return ids[a] < ids[b]; });
+
+        // sections with the same meetings, regardless of the rooms, share a pattern.
+        // The key of a pattern is the number of meetings of each day followed by their (start, end) pairs
+        std::unordered_map<std::u16string, uint32_t> patternIds;
+        std::u16string key;
+        index.patternOffsets.push_back(0);
+        index.roomOffsets.push_back(0);
+        for (int n = 0; n < numSections; n++) {
+            int i = order[n];
+            const auto* header = times + offsets[i];
+            const auto* content = header + 8;
+            key.clear();
+            for (int day = 0; day < 7; day++) {
+                key.push_back((header[day + 1] - header[day]) / 3);
+                for (int j = header[day]; j < header[day + 1]; j += 3) {
+                    key.push_back(content[j]);
+                    key.push_back(content[j + 1]);
+                    index.rooms.push_back(content[j + 2]);
+                }
+            }
+            auto it = patternIds.emplace(key, (uint32_t)patternIds.size()).first;
+            if (it->second == index.patternOffsets.size() - 1) {
+                index.patternTimes.insert(index.patternTimes.end(), header, header + 8);
+                for (int j = 0; j < header[7]; j += 3) index.patternTimes.insert(index.patternTimes.end(), {content[j], content[j + 1], 0});
+                index.patternOffsets.push_back(index.patternTimes.size());
+            }
+            index.ids.push_back(ids[i]);
+            index.patternOf.push_back(it->second);
+            index.dates.insert(index.dates.end(), {dates[2 * i], dates[2 * i + 1]});
+            index.roomOffsets.push_back(index.rooms.size());
+        }
+    }
+    index.buildConflicts();
+    MemoryStats::track(MemoryStats::catalogIndex, index.bytes());
+    TRACE_COUNTER("ScheduleGenerator::timePatterns", index.patterns.size());
+#ifndef _TEST
+    free(ids);
+    free(offsets);
+    free(times);
+    free(dates);
+#endif
+}
+
+/**
+ * gather the inputs of generate for the sections with the given catalog ids from the catalog index
+ * @param numSections number of sections
+ * @param ids the catalog id of each section. A negative id is a placeholder with no meetings, e.g. a skip section
+ * (see setOptionalCourses)
+ * @param dates output, [start, end] date of each section in days
+ * @returns the compact time arrays of the sections in the layout of the timeArray of generate,
+ * or NULL if some section is not in the index or the time arrays are too long
+ */
+uint16_t* gatherSections(int numSections, const int* ids, int* dates) {
+    TRACE_SPAN("ScheduleGenerator::gatherSections");
+    const auto& index = catalogIndex;
+    Arena::Scope scope;
+    auto* idx = Arena::allocArray<int>(numSections);
+    size_t len = numSections * 8;
+    for (int i = 0; i < numSections; i++) {
+        if (ids[i] < 0) {
+            idx[i] = -1;
+            continue;
+        }
+        if ((idx[i] = index.indexOf(ids[i])) < 0) return NULL;
+        len += index.patternTimeArray(index.patternOf[idx[i]])[7];
+    }
+    // the offsets are 16-bit
+    if (len - numSections * 8 > 0xFFFF) return NULL;
+    auto* timeArray = (uint16_t*)malloc(len * sizeof(uint16_t));
+    if (timeArray == NULL) return NULL;
+    auto* content = timeArray + numSections * 8;
+    uint16_t offset = 0;
+    for (int i = 0; i < numSections; i++) {
+        if (idx[i] < 0) {
+            for (int day = 0; day <= 7; day++) timeArray[i * 8 + day] = offset;
+            // the date range of a skip section covers all others, so that it does not make the bitmaps inexact
+            dates[2 * i] = numeric_limits<int>::min();
+            dates[2 * i + 1] = numeric_limits<int>::max();
+            continue;
+        }
+        const auto* header = index.patternTimeArray(index.patternOf[idx[i]]);
+        for (int day = 0; day <= 7; day++) timeArray[i * 8 + day] = offset + header[day];
+        memcpy(content + offset, header + 8, header[7] * sizeof(uint16_t));
+        // the rooms of the section replace the placeholders of the pattern
+        const auto* rooms = index.rooms.data() + index.roomOffsets[idx[i]];
+        for (int j = 0; j < header[7]; j += 3) content[offset + j + 2] = rooms[j / 3];
+        offset += header[7];
+        dates[2 * i] = index.dates[2 * idx[i]];
+        dates[2 * i + 1] = index.dates[2 * idx[i] + 1];
+    }
+    return timeArray;
+}
+
+/**
+ * serialize the catalog index to a binary file (see CatalogIndex::serialize)
+ * @returns pointer to the file, whose third uint32 word is its length in words. It is valid until the next call of this function
+ */
+const uint32_t* exportCatalogIndex() {
+    static vector<uint32_t> file;
+    catalogIndex.serialize(file);
+    return file.data();
+}
+
+/**
+ * load the catalog index from a binary file produced by exportCatalogIndex, replacing the current one
+ * @returns false if the file is malformed, in which case the index is cleared
+ * @note file will be freed by this function
+ */
+bool loadCatalogIndex(uint32_t* file) {
+    TRACE_SPAN("ScheduleGenerator::loadCatalogIndex");
+    MemoryStats::track(MemoryStats::catalogIndex, -(int64_t)catalogIndex.bytes());
+    bool ok = catalogIndex.deserialize(file);
+    MemoryStats::track(MemoryStats::catalogIndex, catalogIndex.bytes());
+#ifndef _TEST
+    free(file);
+#endif
+    return ok;
+}
+
+/**
+ * @param enabled whether to draw evenly spread samples from all valid schedules when there are more than maxNumSchedules of them
+ */
+void setSampling(int enabled) {
+    sampling = enabled;
+}
+
+/**
+ * restrict the view to the schedules matching all clauses of the query, and sort the view.
+ * Answered by the section index without regenerating the schedules
+ * @param query a list of clauses, each of which is [FilterOp, n, n section indices]. It will be freed before this function returns.
+ * Pass an empty query to remove the filter
+ * @param len length of the query
+ * @returns the number of schedules in the view
+ */
+int filterSchedules(int* query, int len) {
+    TRACE_SPAN("ScheduleGenerator::filterSchedules");
+    if (len == 0) {
+        resetView();
+    } else {
+        if (!sectionIndexValid) buildSectionIndex();
+        const Roaring::Bitmap empty;
+        auto sectionSet = [&](int sec) -> const Roaring::Bitmap& {
+            return sec >= 0 && sec < (int)sectionIndex.size() ? sectionIndex[sec] : empty;
+        };
+        // intersect the positive clauses first, so that the universe is only needed if there are none of them
+        Roaring::Bitmap result;
+        bool hasResult = false;
+        for (int i = 0; i < len; i += 2 + query[i + 1]) {
+            int op = query[i], n = query[i + 1];
+            const int* secs = query + i + 2;
+            if (op == excludeAny) continue;
+            Roaring::Bitmap clause;
+            if (op == includeAll) {
+                clause = n > 0 ? sectionSet(secs[0]) : Roaring::range(count);
+                for (int j = 1; j < n; j++) clause = Roaring::intersect(clause, sectionSet(secs[j]));
+            } else {
+                for (int j = 0; j < n; j++) clause = Roaring::unite(clause, sectionSet(secs[j]));
+            }
+            result = hasResult ? Roaring::intersect(result, clause) : std::move(clause);
+            hasResult = true;
+        }
+        if (!hasResult) result = Roaring::range(count);
+        for (int i = 0; i < len; i += 2 + query[i + 1]) {
+            if (query[i] != excludeAny) continue;
+            for (int j = 0; j < query[i + 1]; j++) result = Roaring::subtract(result, sectionSet(query[i + 2 + j]));
+        }
+        viewSchedules.clear();
+        viewSchedules.reserve(result.cardinality());
+        result.forEach([](uint32_t v) { viewSchedules.push_back(v); });
+        viewCount = viewSchedules.size();
+        // if nothing matches, viewSchedules is empty as if not filtered, but viewCount = 0 still hides all schedules
+    }
+#ifndef _TEST
+    free(query);
+#endif
+    trackIndexMemory();
+    sort();
+    return viewCount;
+}
+
+/**
+ * @param budget the time budget in milliseconds of the local search that improves the schedules
+ * when there are more than maxNumSchedules of them. Pass 0 to disable
+ */
+void setSearchBudget(double budget) {
+    searchBudget = budget;
+}
+
+/**
+ * @param layout the EvalLayout of the day patterns used by the next generation
+ */
+void setEvalLayout(int layout) {
+    nextEvalLayout = layout == interleavedLayout ? interleavedLayout : splitLayout;
+}
+
+/**
+ * @returns the array of length = number of sections, whose i-th entry is the index of the course
+ * that eliminated section i before the search, or -1 if section i is not eliminated
+ */
+const int16_t* getPrunedSections() {
+    return prunedBy;
+}
+
+/**
+ * @returns the array of length = number of sections, whose i-th entry is the number of valid schedules containing section i.
+ * A section with count 0 cannot appear in any valid schedule. The counts are exact if getTotalCount() >= 0,
+ * otherwise they only cover the schedules generated
+ */
+const double* getSectionCounts() {
+    return sectionCounts.data();
 }
 
 uint16_t* getSchedule(int idx) {
-    return schedules + indices[idx] * numCourses;
+    return scheduleAt(indices[idx]);
+}
+
+/**
+ * export a page of sorted schedules into a single packed buffer. The buffer consists of, in order,
+ * - header: int32 [count, numCourses, flags, NUM_METRICS]
+ * - the section indices of each schedule: uint16 [count * numCourses], padded to 4 bytes
+ * - if flags & exportMetrics: the value of each sort function of each schedule: float32 [count * NUM_METRICS].
+ *   The value is NaN if the function cannot be evaluated (e.g. similarity without a reference schedule)
+ * - if flags & exportBlocks: the start offset of the blocks of each schedule: int32 [count + 1],
+ *   followed by the blocks of all schedules: uint16, 8 offsets of the days followed by the (start, end, room) triples
+ * @param start the index of the first schedule, in the sorted order
+ * @param num the number of schedules. It is truncated at the end of the schedules
+ * @param flags bitwise OR of the ExportFlag values
+ * @returns pointer to the buffer. It is valid until the next call of this function
+ */
+const uint32_t* exportPage(int start, int num, int flags) {
+    TRACE_SPAN("ScheduleGenerator::exportPage");
+    start = std::max(0, std::min(start, viewCount));
+    num = std::max(0, std::min(num, viewCount - start));
+
+    int idLen = (num * numCourses + 1) / 2, blockLen = 0;
+    if (flags & exportBlocks) {
+        for (int i = start; i < start + num; i++) {
+            blockLen += 8;
+            for (int j = 0; j < 7; j++) {
+                uint32_t p = dayPattern(indices[i], j);
+                blockLen += (patternBounds[p + 1] - patternBounds[p]) * 3;
+            }
+        }
+    }
+    size_t len = 4 + idLen + ((flags & exportMetrics) ? num * NUM_METRICS : 0) +
+                 ((flags & exportBlocks) ? num + 1 + (blockLen + 1) / 2 : 0);
+    pageBuffer.assign(len, 0);
+    auto* __restrict__ buf = pageBuffer.data();
+    buf[0] = num;
+    buf[1] = numCourses;
+    buf[2] = flags;
+    buf[3] = NUM_METRICS;
+    auto* ids = (uint16_t*)(buf + 4);
+    for (int i = 0; i < num; i++) memcpy(ids + i * numCourses, scheduleAt(indices[start + i]), numCourses * sizeof(uint16_t));
+    auto* next = buf + 4 + idLen;
+
+    if (flags & exportMetrics) {
+        auto* metrics = (float*)next;
+        for (int f = 0; f < NUM_METRICS; f++) {
+            const auto* cached = sortCoeffCache[f].coeffs;
+            // the distance and similarity cannot be computed without their inputs
+            bool available = cached != NULL || (f == 0 ? timeMatrix != NULL : f == 5 ? refSchedule != NULL : true);
+            for (int i = 0; i < num; i++) {
+                int idx = indices[start + i];
+                metrics[i * NUM_METRICS + f] = !available ? numeric_limits<float>::quiet_NaN()
+                                                          : cached != NULL ? cached[idx] : sortFunctions[f](idx);
+            }
+        }
+        next += num * NUM_METRICS;
+    }
+    if (flags & exportBlocks) {
+        auto* blockOffsets = (int*)next;
+        auto* dst = (uint16_t*)(next + num + 1);
+        int offset = 0;
+        for (int i = 0; i < num; i++) {
+            // expand the day patterns into 8 offsets followed by the triples of each day
+            auto* block = dst + offset;
+            int bound = 8;
+            for (int j = 0; j < 7; j++) {
+                block[j] = bound;
+                uint32_t p = dayPattern(indices[start + i], j);
+                for (uint32_t k = patternBounds[p]; k < patternBounds[p + 1]; k++, bound += 3) {
+                    block[bound] = patternStarts[k];
+                    block[bound + 1] = patternEnds[k];
+                    block[bound + 2] = patternRooms[k];
+                }
+            }
+            block[7] = bound;
+            blockOffsets[i] = offset;
+            offset += bound;
+        }
+        blockOffsets[num] = offset;
+    }
+    return buf;
+}
+
+/**
+ * set the events laid out by renderSchedule
+ * @param events 8 offsets of the days followed by the (start, end) pairs. It is owned by this module afterwards
+ */
+void setRenderEvents(uint16_t* events) {
+    free(renderEvents);
+    renderEvents = events;
+}
+
+#ifndef _TEST
+/**
+ * lay out the blocks of the schedule at idx in the sorted order, together with the events set by setRenderEvents,
+ * directly from its day patterns, so that they do not need to be exported and copied back to the renderer
+ * @returns pointer to a buffer of float64: 8 offsets of the days, in blocks, followed by the (start, end, left, width) of each block.
+ * The blocks of a day are its classes sorted by the start time, followed by its events.
+ * It is NULL if idx is out of range or the renderer is out of memory, and valid until the next call of this function
+ */
+const double* renderSchedule(int idx) {
+    TRACE_SPAN("ScheduleGenerator::renderSchedule");
+    if (idx < 0 || idx >= viewCount) return NULL;
+    Arena::Scope scope;
+    Arena::ScratchVector<Renderer::TimeEntry<int16_t>> day;
+    Arena::ScratchVector<double> layouts;
+    renderBuffer.assign(8, 0.0);
+    int offset = 0;
+    for (int j = 0; j < 7; j++) {
+        renderBuffer[j] = offset;
+        day.clear();
+        uint32_t p = dayPattern(indices[idx], j);
+        for (uint32_t k = patternBounds[p]; k < patternBounds[p + 1]; k++)
+            day.push_back({(int16_t)patternStarts[k], (int16_t)patternEnds[k]});
+        if (renderEvents != NULL) {
+            for (int n = 8 + renderEvents[j], e = 8 + renderEvents[j + 1]; n < e; n += 2)
+                day.push_back({(int16_t)renderEvents[n], (int16_t)renderEvents[n + 1]});
+        }
+        int len = day.size();
+        if (len == 0) continue;
+        layouts.resize(len * 2);
+        if (!Renderer::layout(day.data(), len, layouts.data())) return NULL;
+        for (int i = 0; i < len; i++) {
+            renderBuffer.push_back(day[i].startMin);
+            renderBuffer.push_back(day[i].endMin);
+            renderBuffer.push_back(layouts[2 * i]);
+            renderBuffer.push_back(layouts[2 * i + 1]);
+        }
+        offset += len;
+    }
+    renderBuffer[7] = offset;
+    return renderBuffer.data();
 }
+#endif
 
 float getRange(int idx) {
     return sortCoeffCache[idx].max - sortCoeffCache[idx].min;
@@ -607,11 +3023,7 @@ float getRange(int idx) {
 void setRefSchedule(uint16_t* ref) {
     if (refSchedule != NULL) free(refSchedule);
     refSchedule = ref;
-    auto& cache = sortCoeffCache[5];
-    if (cache.coeffs != NULL) {
-        delete[] cache.coeffs;
-        cache.coeffs = NULL;
-    }
+    freeCoeffCache(5);
 }
 }
 
@@ -636,16 +3048,16 @@ int main() {
     conflict[0 + 1] = 1;
     conflict[2] = 1;
     int secLens[3] = {0, 2, 4};
-    ScheduleGenerator::generate(2, 10, secLens, conflict, timeArray);
-    for (int i = 0; i < 4; i++) {
+    ScheduleGenerator::generate(2, 10, secLens, conflict, timeArray, NULL);
+    for (int i = 0; i < ScheduleGenerator::count; i++) {
         for (int j = 0; j < 2; j++) {
-            cout << (int)schedules[i * 2 + j] << ",";
+            cout << (int)scheduleAt(i)[j] << ",";
         }
         cout << endl;
     }
     cout << ScheduleGenerator::count << endl;
-    for (int i = 0; i < (8 + 12) * 4; i++) {
-        cout << blocks[i] << ",";
+    for (int i = 0; i < 7 * ScheduleGenerator::count; i++) {
+        cout << dayPatterns[i] << ",";
         /* code */
     }
     cout << endl;
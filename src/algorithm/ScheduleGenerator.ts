@@ -13,7 +13,17 @@ import GeneratedSchedule from '../models/GeneratedSchedule';
 import ProposedSchedule from '../models/ProposedSchedule';
 import { NotiMsg } from '../store/notification';
 import { calcOverlap, parseDate } from '../utils';
-import ScheduleEvaluator, { EvaluatorOptions } from './ScheduleEvaluator';
+import Section from '../models/Section';
+import { hasCatalogIndex } from './CatalogIndex';
+import { loadSolver } from './Solver';
+import { formatNativeMemoryUsage, releaseNativeMemory } from './MemoryStats';
+import { traceEnd, traceStart } from './Trace';
+import ScheduleEvaluator, {
+    encodeRefSchedule,
+    EvaluatorOptions,
+    setNativeSortOptions,
+    SortMode
+} from './ScheduleEvaluator';
 
 /**
  * TODO: add description
@@ -38,6 +48,16 @@ export type MeetingDate = [number, number];
  */
 export type RawAlgoCourse = [string, number[]];
 
+/**
+ * a (combined) section removed before the search,
+ * because it conflicts with all sections of another course that can be scheduled
+ */
+export interface PrunedSection {
+    section: RawAlgoCourse;
+    /** key of the course that conflicts with this section */
+    conflictsWith: string;
+}
+
 /**
  * return true if two [[TimeArray]] objects have overlapping time blocks, false otherwise
  * @param timeArray1
@@ -97,24 +117,86 @@ function timeArrayToCompact(Module: EMModule, timeArrays: TimeArray[]) {
 }
 
 /**
- * pre-compute `conflictCache` using `timeArrayList` and `dateList`
+ * concatenate the time arrays of (start, end) pairs (e.g. of the events) day by day into a single compact time array:
+ * 8 offsets followed by the pairs
  */
-function computeConflict(
-    timeArrayList: TimeArray[],
-    dateList: MeetingDate[],
-    conflictCache: Uint8Array
+function blocksToCompact(Module: EMModule, timeArrays: TimeArray[]) {
+    let len = 8;
+    for (const arr of timeArrays) {
+        for (const day of arr) len += day.length;
+    }
+    const ptr = Module._malloc(len * 2);
+    const arr = Module.HEAPU16.subarray(ptr / 2, ptr / 2 + len);
+    len = 0;
+    for (let k = 0; k < 7; k++) {
+        arr[k] = len;
+        for (const timeArray of timeArrays) {
+            arr.set(timeArray[k], len + 8);
+            len += timeArray[k].length;
+        }
+    }
+    arr[7] = len;
+    return ptr;
+}
+
+/**
+ * compute the cost of each section for the parts of the sort options that decompose per section:
+ * the dissimilarity to the reference schedule, and the early and lunch time penalties linearised over the meetings.
+ * The other sort options are ignored. Each part is normalized to [0, 1] and weighted like the combined sort mode
+ * @param timeArray the compact time arrays of the sections
+ * @param ref the index of the referenced section of each course (see [[encodeRefSchedule]]), or null if there is none
+ * @param costs output, of length = number of sections
+ * @returns false if no enabled sort option decomposes per section
+ */
+export function computeSectionCosts(
+    timeArray: Uint16Array,
+    secLens: number[],
+    options: EvaluatorOptions,
+    ref: Uint16Array | null,
+    costs: Float32Array
 ) {
-    const numSections = timeArrayList.length;
-    // pre-compute the conflict between each pair of sections
-    for (let i = 0; i < numSections; i++) {
-        for (let j = i + 1; j < numSections; j++) {
-            // conflict is symmetric
-            conflictCache[i * numSections + j] = conflictCache[j * numSections + i] = +(
-                checkTimeConflict(timeArrayList[i], timeArrayList[j], 3, 3) &&
-                calcOverlap(dateList[i][0], dateList[i][1], dateList[j][0], dateList[j][1]) !== -1
-            );
+    const numSections = secLens[secLens.length - 1];
+    const enabled = options.sortBy.filter(x => x.enabled);
+    const part = new Float32Array(numSections);
+    let found = false;
+    costs.fill(0);
+    for (let rank = 0; rank < enabled.length; rank++) {
+        const option = enabled[rank];
+        part.fill(0);
+        if (option.name === 'similarity') {
+            if (!ref) continue;
+            for (let i = 0; i < secLens.length - 1; i++) {
+                for (let j = secLens[i]; j < secLens[i + 1]; j++) part[j] = +(ref[i] !== j);
+            }
+        } else if (option.name === 'noEarly' || option.name === 'lunchTime') {
+            for (let j = 0; j < numSections; j++) {
+                for (let k = timeArray[j * 8]; k < timeArray[j * 8 + 7]; k += 3) {
+                    const start = timeArray[numSections * 8 + k],
+                        end = timeArray[numSections * 8 + k + 1];
+                    part[j] +=
+                        option.name === 'noEarly'
+                            ? Math.max(720 - start, 0) ** 2
+                            : Math.max(Math.min(end, 840) - Math.max(start, 660), 0);
+                }
+            }
+        } else {
+            continue;
         }
+        found = true;
+        let max = 0;
+        for (let j = 0; j < numSections; j++) max = Math.max(max, part[j]);
+        if (max === 0) continue;
+        // a single option is not weighted. In the fallback mode, each option weighs 1000 times less than the previous one
+        const weight =
+            enabled.length === 1
+                ? 1
+                : options.mode === SortMode.combined
+                ? option.weight
+                : 1e-3 ** rank;
+        for (let j = 0; j < numSections; j++)
+            costs[j] += (weight * (option.reverse ? max - part[j] : part[j])) / max;
     }
+    return found;
 }
 
 export interface GeneratorOptions {
@@ -123,6 +205,34 @@ export interface GeneratorOptions {
     sortOptions: EvaluatorOptions;
     combineSections: boolean;
     maxNumSchedules: number;
+    /**
+     * when there are more than `maxNumSchedules` schedules,
+     * whether to keep samples spread evenly over all of them instead of the first `maxNumSchedules` ones
+     */
+    sampling?: boolean;
+    /**
+     * when there are more than `maxNumSchedules` schedules, the time in milliseconds spent on searching for
+     * better schedules according to the sort options, instead of keeping the first `maxNumSchedules` ones. 0 to disable
+     */
+    searchBudget?: number;
+    /**
+     * generate the best schedules in order according to the sort options that decompose per section
+     * (see [[computeSectionCosts]]), even if the schedules cannot be enumerated
+     */
+    optimal?: boolean;
+    /**
+     * courses that may be left out, so that a single generation explores which of them to take
+     * together with their sections. Each group of sections of these courses gets a skip section,
+     * which is chosen when the group is not taken
+     */
+    optionalCourses?: {
+        /** keys of the optional courses */
+        keys: string[];
+        /** the minimum number of optional groups taken */
+        min: number;
+        /** the maximum number of optional groups taken */
+        max: number;
+    };
 }
 
 /**
@@ -144,17 +254,21 @@ class ScheduleGenerator {
         schedule: ProposedSchedule,
         refSchedule: GeneratedSchedule['All'] = {}
     ): NotiMsg<ScheduleEvaluator> {
-        console.time('algorithm bootstrapping');
+        const bootstrapStart = traceStart();
 
         // convert events to TimeArrays so that we can easily check for time conflict
         const timeSlots: TimeArray[] = schedule.events.map(e => e.toTimeArray());
         for (const event of this.options.timeSlots) timeSlots.push(event.toTimeArray());
 
-        const classList: RawAlgoCourse[] = [];
-        const timeArrayList: TimeArray[] = [];
-        const dateList: MeetingDate[] = [];
+        // the candidate sections of all courses, before being filtered against the time slots
+        const candidates: RawAlgoCourse[] = [];
+        // the section whose time and date are used for each candidate, or null for a skip section
+        const candidateSections: (Section | null)[] = [];
+        const candidateDates: MeetingDate[] = [];
+        // the display name, the number of candidate sections and whether it is optional of each course
+        const groups: [string, number, boolean][] = [];
+        const optionalKeys = this.options.optionalCourses ? this.options.optionalCourses.keys : [];
 
-        const secLens = [0];
         const courses = schedule.All;
 
         const msgs: NotiMsg<ScheduleEvaluator>[] = [];
@@ -171,34 +285,24 @@ class ScheduleGenerator {
                 if (subgroup instanceof Set && subgroup.size === 0) continue;
 
                 const courseRec = this.catalog.getCourse(key, subgroup);
+                const displayName = `${courseRec.displayName}${
+                    i === 0 || subgroup === -1 ? '' : ' belonging to group ' + i // don't show group idx for default group or Any Section
+                }`;
 
-                const [classes, timeArrays, dates, allInvalid] = this.filterSections(
-                    courseRec,
-                    timeSlots
-                );
+                const [classes, sections, dates] = this.filterSections(courseRec);
+                const optional = optionalKeys.includes(key);
 
                 noSelected = false;
-                // give an warning if none of the sections pass the filter
-                if (classes.length === 0) {
-                    msgs.push({
-                        level: 'warn',
-                        msg: `Not scheduled: ${courseRec.displayName}${
-                            i === 0 || subgroup === -1 ? '' : ' belonging to group ' + i // don't show group idx for default group or Any Section
-                        }. Reason: No sections satisfy your filters and do not conflict with your events`
-                    });
-                } else {
-                    secLens.push(classes.length);
-                    classList.push(...classes);
-                    timeArrayList.push(...timeArrays);
-                    dateList.push(...dates);
-                }
-                if (allInvalid) {
-                    msgs.push({
-                        level: 'warn',
-                        msg: `Warning: No sections of ${courseRec.displayName}${
-                            i === 0 || subgroup === -1 ? '' : ' belonging to group ' + i // don't show group idx for default group or Any Section
-                        } have valid meeting times (e.g. All TBA/TBD/Online Asynchronous). It will not be shown on the schedule grid.`
-                    });
+                groups.push([displayName, classes.length + +optional, optional]);
+                candidates.push(...classes);
+                candidateSections.push(...sections);
+                candidateDates.push(...dates);
+                // the skip section has no meetings, so it is always the last one after the filtering.
+                // Its date range covers all others (the range of Date), so that it does not make the bitmaps inexact
+                if (optional) {
+                    candidates.push([key, []]);
+                    candidateSections.push(null);
+                    candidateDates.push([-8.64e15, 8.64e15]);
                 }
             }
             if (noSelected) {
@@ -210,8 +314,123 @@ class ScheduleGenerator {
                 };
             }
         }
+        const { optionalCourses } = this.options;
+        if (optionalCourses) {
+            const { min, max } = optionalCourses;
+            const numOptional = groups.filter(g => g[2]).length;
+            if (min > max) {
+                return {
+                    level: 'error',
+                    msg: `The minimum number of optional courses taken (${min}) is greater than the maximum (${max})!`
+                };
+            }
+            if (min > numOptional) {
+                return {
+                    level: 'error',
+                    msg: `Cannot take at least ${min} optional courses: only ${numOptional} of them are in the schedule!`
+                };
+            }
+        }
+        const Module = window.NativeModule;
+
+        // the time arrays and the [start, end] dates in days of the candidates are gathered from the catalog index
+        // if it is ready. Otherwise, they are converted from the sections
+        const candidateIds = candidateSections.map(s => (s ? s.id : -1));
+        const candidateDatePtr = Module._malloc(candidates.length * 8);
+        let timeArrayPtr = 0;
+        if (hasCatalogIndex(this.catalog)) {
+            const idPtr = Module._malloc(candidates.length * 4);
+            Module.HEAP32.set(candidateIds, idPtr / 4);
+            timeArrayPtr = Module._gatherSections(candidates.length, idPtr, candidateDatePtr);
+            Module._free(idPtr);
+        }
+        if (!timeArrayPtr) {
+            timeArrayPtr = timeArrayToCompact(
+                Module,
+                candidateSections.map(s => (s ? s.getTimeRoom() : [[], [], [], [], [], [], []]))
+            );
+            const days = Module.HEAP32.subarray(candidateDatePtr / 4);
+            for (let i = 0; i < candidates.length; i++) {
+                days[2 * i] = Math.floor(candidateDates[i][0] / 864e5);
+                days[2 * i + 1] = Math.floor(candidateDates[i][1] / 864e5);
+            }
+        }
+        // warn about the courses none of whose sections meet at all
+        for (let i = 0, start = 0; i < groups.length; start += groups[i++][1]) {
+            // the skip section is not a real section
+            const end = start + groups[i][1] - +groups[i][2];
+            // no section passes the status filter, which is reported as not scheduled below
+            if (end === start) continue;
+            let allInvalid = true;
+            for (let j = start; j < end && allInvalid; j++)
+                allInvalid =
+                    Module.HEAPU16[timeArrayPtr / 2 + j * 8] ===
+                    Module.HEAPU16[timeArrayPtr / 2 + j * 8 + 7];
+            if (allInvalid) {
+                msgs.push({
+                    level: 'warn',
+                    msg: `Warning: No sections of ${groups[i][0]} have valid meeting times (e.g. All TBA/TBD/Online Asynchronous). It will not be shown on the schedule grid.`
+                });
+            }
+        }
 
+        // remove the sections conflicting with the time slots natively. The time arrays are compacted in place
+        const survivorPtr =
+            Module._filterSections(
+                candidates.length,
+                timeArrayPtr,
+                blocksToCompact(Module, timeSlots)
+            ) / 4;
+        const survivors = Module.HEAP32.subarray(
+            survivorPtr + 1,
+            survivorPtr + 1 + Module.HEAP32[survivorPtr]
+        );
+
+        const classList: RawAlgoCourse[] = [];
+        const idList: number[] = [];
+        const secLens = [0];
+        // whether each course passed to the generator is optional
+        const optionalFlags: boolean[] = [];
+        // [start, end] date of each section in days. Conflicts are computed natively from the dates and time arrays
+        const datePtr = Module._malloc(survivors.length * 8);
+        const dates = Module.HEAP32.subarray(datePtr / 4, datePtr / 4 + survivors.length * 2);
+        const candidateDays = Module.HEAP32.subarray(
+            candidateDatePtr / 4,
+            candidateDatePtr / 4 + candidates.length * 2
+        );
+        let start = 0,
+            n = 0;
+        for (const [displayName, len, optional] of groups) {
+            const end = start + len;
+            const first = n;
+            while (n < survivors.length && survivors[n] < end) n++;
+            // give an warning if none of the sections (other than the skip section) pass the filter
+            if (n - first === +optional) {
+                msgs.push({
+                    level: 'warn',
+                    msg: `Not scheduled: ${displayName}. Reason: No sections satisfy your filters and do not conflict with your events`
+                });
+            }
+            // the time arrays of the survivors are already compacted, so an optional course is kept
+            // even if only its skip section survives. Then it is simply never taken
+            if (n > first) {
+                for (let i = first; i < n; i++) {
+                    const k = classList.length;
+                    classList.push(candidates[survivors[i]]);
+                    idList.push(candidateIds[survivors[i]]);
+                    dates[2 * k] = candidateDays[2 * survivors[i]];
+                    dates[2 * k + 1] = candidateDays[2 * survivors[i] + 1];
+                }
+                secLens.push(n - first);
+                optionalFlags.push(optional);
+            }
+            start = end;
+        }
+
+        Module._free(candidateDatePtr);
         if (classList.length === 0) {
+            Module._free(timeArrayPtr);
+            Module._free(datePtr);
             return {
                 level: 'error',
                 msg: 'Given your filter, we cannot generate schedules without overlapping classes'
@@ -221,45 +440,148 @@ class ScheduleGenerator {
         for (let i = 1; i < secLens.length; i++) {
             secLens[i] += secLens[i - 1];
         }
-        const Module = window.NativeModule;
 
         // pointer to the cache for the number of sections in each course
         const secLenPtr = Module._malloc(secLens.length * 4);
         Module.HEAP32.set(secLens, secLenPtr / 4);
 
-        // the side length of the conflict cache matrix
-        const _size = classList.length ** 2;
-        const conflictCachePtr = Module._malloc(_size);
-
-        // prepare the conflictCache
-        computeConflict(
-            timeArrayList,
-            dateList,
-            Module.HEAPU8.subarray(conflictCachePtr, conflictCachePtr + _size)
-        );
-        console.timeEnd('algorithm bootstrapping');
-
-        console.time('running algorithm:');
-        const size = Module._generate(
-            secLens.length - 1,
-            this.options.maxNumSchedules,
-            secLenPtr,
-            conflictCachePtr,
-            timeArrayToCompact(Module, timeArrayList)
-        );
-        console.timeEnd('running algorithm:');
+        traceEnd('ScheduleGenerator.getSchedules::bootstrap', bootstrapStart);
+
+        const generateStart = traceStart();
+        Module._setSampling(+!!this.options.sampling);
+        Module._setSearchBudget(this.options.searchBudget || 0);
+        if (this.options.searchBudget) {
+            // the local search optimizes the sort objective, so it needs the sort options before the generation
+            setNativeSortOptions(Module, this.options.sortOptions);
+            if (Object.keys(refSchedule).length) {
+                const numCourses = secLens.length - 1;
+                const refPtr = Module._malloc(numCourses * 2);
+                encodeRefSchedule(
+                    refSchedule,
+                    classList,
+                    secLens,
+                    Module.HEAPU16.subarray(refPtr / 2, refPtr / 2 + numCourses)
+                );
+                Module._setRefSchedule(refPtr);
+            }
+        }
+        // similarity decomposes into the costs of individual sections,
+        // so when it is the only sort option, the most similar schedules are generated directly in order.
+        // In the optimal mode, the other sort options that (approximately) decompose are included as well
+        const enabled = this.options.sortOptions.sortBy.filter(x => x.enabled);
+        const hasRef = Object.keys(refSchedule).length > 0;
+        let sectionCosts: Float32Array | null = null;
+        if (
+            this.options.optimal ||
+            (enabled.length === 1 && enabled[0].name === 'similarity' && !enabled[0].reverse && hasRef)
+        ) {
+            // in the optimal mode, the optimal schedules beyond the enumerable ones are found by the solver,
+            // which is fetched on first use. This generation falls back to enumeration if it is not loaded yet
+            if (this.options.optimal) loadSolver();
+            const numCourses = secLens.length - 1;
+            const ref = hasRef
+                ? encodeRefSchedule(refSchedule, classList, secLens, new Uint16Array(numCourses))
+                : null;
+            const costs = new Float32Array(classList.length);
+            const timeArray = Module.HEAPU16.subarray(timeArrayPtr / 2);
+            if (computeSectionCosts(timeArray, secLens, this.options.sortOptions, ref, costs))
+                sectionCosts = costs;
+        }
+        // the options of the generation are consumed by each attempt, even if it fails, so they are set every time
+        const runGenerate = () => {
+            // the conflicts of the sections in the catalog index are looked up instead of computed
+            if (hasCatalogIndex(this.catalog)) {
+                const idPtr = Module._malloc(idList.length * 4);
+                Module.HEAP32.set(idList, idPtr / 4);
+                Module._setSectionIds(idPtr);
+            }
+            // the limits are passed even if no optional course passes the filter,
+            // in which case min > 0 cannot be satisfied
+            if (optionalCourses) {
+                const { min, max } = optionalCourses;
+                const optionalPtr = Module._malloc(optionalFlags.length);
+                Module.HEAPU8.set(
+                    optionalFlags.map(x => +x),
+                    optionalPtr
+                );
+                Module._setOptionalCourses(optionalPtr, min, max);
+            }
+            if (sectionCosts) {
+                const costPtr = Module._malloc(sectionCosts.length * 4);
+                Module.HEAPF32.set(sectionCosts, costPtr / 4);
+                Module._setSectionCosts(costPtr, +!!this.options.optimal);
+            }
+            return Module._generate(
+                secLens.length - 1,
+                this.options.maxNumSchedules,
+                secLenPtr,
+                0,
+                timeArrayPtr,
+                datePtr
+            );
+        };
+        let size = runGenerate();
+        if (size < 0) {
+            // the inputs are not freed on failure, so we can release the native caches and retry once
+            releaseNativeMemory();
+            size = runGenerate();
+        }
+        traceEnd('ScheduleGenerator.getSchedules::generate', generateStart);
 
-        if (size < 0)
+        if (size < 0) {
+            Module._free(secLenPtr);
+            Module._free(timeArrayPtr);
+            Module._free(datePtr);
             return {
                 level: 'error',
-                msg: 'Out of memory! Please try to reduce the max number of schedules'
+                msg: `Out of memory! Please try to reduce the max number of schedules. Memory in use: ${formatNativeMemoryUsage()}`
             };
-        if (size === 0)
+        }
+
+        // prunedBy[i] is the index of the course that conflicts with all remaining sections of classList[i], or -1
+        const prunedPtr = Module._getPrunedSections() / 2;
+        const prunedBy = Module.HEAP16.slice(prunedPtr, prunedPtr + classList.length);
+        const pruned: PrunedSection[] = [];
+        for (let i = 0; i < classList.length; i++) {
+            if (prunedBy[i] >= 0)
+                pruned.push({
+                    section: classList[i],
+                    conflictsWith: classList[secLens[prunedBy[i]]][0]
+                });
+        }
+        if (size === 0) {
+            // the optional courses with some sections other than the skip section
+            const numOptional = optionalFlags.filter(
+                (x, i) => x && secLens[i + 1] - secLens[i] > 1
+            ).length;
+            if (optionalCourses && numOptional < optionalCourses.min) {
+                return {
+                    level: 'error',
+                    msg: `Cannot take at least ${optionalCourses.min} optional courses: only ${numOptional} of them have sections satisfying your filters`
+                };
+            }
+            // explain the infeasibility if all sections of some course are removed by the preprocessing
+            for (let i = 0; i < secLens.length - 1; i++) {
+                if (prunedBy.subarray(secLens[i], secLens[i + 1]).some(x => x < 0)) continue;
+                const culprits = new Set<string>();
+                for (let j = secLens[i]; j < secLens[i + 1]; j++)
+                    culprits.add(this.catalog.getCourse(classList[secLens[prunedBy[j]]][0]).displayName);
+                return {
+                    level: 'error',
+                    msg: `Given your filter, we cannot generate schedules without overlapping classes. All sections of ${
+                        this.catalog.getCourse(classList[secLens[i]][0]).displayName
+                    } conflict with ${[...culprits].join(', ')}`
+                };
+            }
             return {
                 level: 'error',
                 msg: 'Given your filter, we cannot generate schedules without overlapping classes'
             };
+        }
 
+        // the displayed events are laid out together with the classes of the generated schedules
+        const displayed = schedule.events.filter(e => e.display).map(e => e.toTimeArray());
+        Module._setRenderEvents(blocksToCompact(Module, displayed));
         const evaluator = new ScheduleEvaluator(
             this.options.sortOptions,
             schedule.events,
@@ -268,21 +590,35 @@ class ScheduleGenerator {
             refSchedule,
             window.NativeModule
         );
+        evaluator.pruned = pruned;
+        // counts[i] is the number of valid schedules containing classList[i]
+        const countPtr = Module._getSectionCounts() / 8;
+        evaluator.sectionCounts = Module.HEAPF64.slice(countPtr, countPtr + classList.length);
 
         evaluator.sort();
 
         let msgString = '';
         for (const msg of msgs) msgString += msg.msg + '<br>';
+        // the total number is known if the search is exhaustive or the subproblems are memoised
+        const total = Module._getTotalCount();
+        evaluator.countTotal = total >= 0 ? total : size;
         return {
             level: msgs.length > 0 ? 'warn' : 'success',
-            msg: `${msgString}${size} Schedules Generated!`,
+            msg: `${msgString}${size} Schedules Generated!${
+                total > size ? ` (out of ${total.toLocaleString()} possible schedules)` : ''
+            }`,
             payload: evaluator
         };
     }
 
-    private filterSections(courseRec: Course, timeSlots: TimeArray[]) {
+    /**
+     * collect the (combined) sections of a course with the allowed status and valid dates,
+     * and the section whose time and date are used for each of them.
+     * Conflicts with the time slots are checked natively afterwards
+     */
+    private filterSections(courseRec: Course) {
         const classes: RawAlgoCourse[] = [],
-            timeArrays: TimeArray[] = [],
+            firsts: Section[] = [],
             dates: MeetingDate[] = [];
 
         // combine all sections of this course occurring at the same time, if enabled
@@ -290,24 +626,14 @@ class ScheduleGenerator {
             ? Object.values(courseRec.getCombined())
             : courseRec.sections.map(s => [s]);
 
-        let allInvalid = true;
         // for each combined section, form a RawAlgoCourse
-        outer: for (const sections of combined) {
+        for (const sections of combined) {
             // only take the time and room info of the first section
             // time will be the same for sections in this array
             // but rooms..., well this is a compromise
             const date = parseDate(sections[0].dates);
             if (!date) continue;
 
-            const timeArray = sections[0].getTimeRoom();
-            if (timeArray.some(arr => arr.length > 0)) {
-                allInvalid = false;
-
-                // don't include this combined section if it conflicts with any time filter or event.
-                for (const td of timeSlots) {
-                    if (checkTimeConflict(td, timeArray, 2, 3)) continue outer;
-                }
-            }
             const secIndices: number[] = [];
             for (const section of sections) {
                 // filter out sections with unwanted status
@@ -318,12 +644,12 @@ class ScheduleGenerator {
 
             if (secIndices.length) {
                 classes.push([courseRec.key, secIndices]);
-                timeArrays.push(timeArray);
+                firsts.push(sections[0]);
                 dates.push(date);
             }
         }
 
-        return [classes, timeArrays, dates, allInvalid] as const;
+        return [classes, firsts, dates] as const;
     }
 }
 
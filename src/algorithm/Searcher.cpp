@@ -1,25 +1,33 @@
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iostream>
+#include <string>
 #include <string_view>
 #include <vector>
 
+#include "Arena.hpp"
+
 #ifdef USE_FLATMAP
 
 #include "parallel-hashmap/parallel_hashmap/phmap.h"
-template <typename K, typename V>
-using HashMap = phmap::flat_hash_map<K, V>;
+template <typename K, typename V, typename Alloc = phmap::Allocator<phmap::Pair<const K, V>>>
+using HashMap = phmap::flat_hash_map<K, V, phmap::Hash<K>, phmap::EqualTo<K>, Alloc>;
 
 #else
 
 #include <unordered_map>
-template <typename K, typename V>
-using HashMap = std::unordered_map<K, V>;
+template <typename K, typename V, typename Alloc = std::allocator<std::pair<const K, V>>>
+using HashMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, Alloc>;
 
 #endif
 
+#include "MemoryStats.hpp"
+#include "Trace.hpp"
+
 using namespace std;
-using GramMap = HashMap<string_view, int16_t*>;
+// query grams only live during a single search, so they are allocated from the scratch arena
+using GramMap = HashMap<string_view, int16_t*, Arena::ScratchAllocator<pair<const string_view, int16_t*>>>;
 
 namespace Searcher {
 
@@ -27,10 +35,26 @@ struct Match {
     int start, end;
 };
 
+/**
+ * an entry of the postings list of a token
+ */
+struct Posting {
+    // index of the sentence that contains the token
+    int sentence;
+    // number of times the token occurs in that sentence
+    int tf;
+};
+
 struct Token {
     string_view token;
     float score;
     vector<Match> matches;
+    // sentences containing this token, in ascending order of sentence index
+    vector<Posting> postings;
+    // inverse document frequency of this token
+    float idf;
+    // the maximum BM25 contribution of this token to any sentence, used as the upper bound in MaxScore
+    float maxImpact;
 };
 
 // an indexed token contains an index/pointer to the array of unique tokens
@@ -54,11 +78,32 @@ struct Sentence {
     float score;
     // matches for this sentence (computed after a search)
     vector<Match> matches;
+    // number of tokens in this sentence, normalized by the average sentence length
+    float normLen;
     ~Sentence() {
         free((void*)_original);
     }
 };
 
+/**
+ * the maximum number of suggestions returned by autocomplete
+ */
+constexpr int AUTOCOMPLETE_K = 8;
+
+/**
+ * a node of the prefix trie built over the unique tokens.
+ * The tokens completing the prefix of a node form a contiguous range in the sorted token array
+ */
+struct TrieNode {
+    // range [lo, hi) of the sorted token array
+    int lo, hi;
+    // the children are stored in trieChars/trieChildren[firstEdge, firstEdge + numEdges), sorted by byte
+    int firstEdge, numEdges;
+    // offset of the top AUTOCOMPLETE_K tokens in topTokens and of the top sentences in topSentences,
+    // or -1 if hi - lo <= AUTOCOMPLETE_K
+    int topOffset;
+};
+
 /**
  * represents an instance of FastSearcher
  * In theroy this can be written as a c++ class, 
@@ -72,8 +117,36 @@ struct FastSearcher {
     float* scoreWindow;
     int* indices;
     vector<Token> uniqueTokens;
+    // map a token to an index in the uniqueTokens array
+    HashMap<string_view, int> str2num;
+    // number of valid entries in indices after the last ranked (BM25) search
+    int numResults;
+
+    // indices of uniqueTokens in lexicographical order
+    vector<int> sortedTokens;
+    // the prefix trie. Node 0 is the root
+    vector<TrieNode> trie;
+    // the bytes are unsigned, which is the order of the sorted tokens
+    vector<uint8_t> trieChars;
+    vector<int> trieChildren;
+    // top tokens of the trie nodes whose ranges are larger than AUTOCOMPLETE_K
+    vector<int> topTokens;
+    // top sentences of the same nodes, padded with -1 if fewer than AUTOCOMPLETE_K sentences contain their tokens
+    vector<int> topSentences;
+    // approximate number of bytes held by this searcher
+    uint32_t memSize;
 };
 
+/**
+ * BM25 parameters: term frequency saturation and length normalization
+ */
+constexpr float BM25_K1 = 1.2f;
+constexpr float BM25_B = 0.75f;
+
+inline float bm25Impact(float idf, int tf, float normLen) {
+    return idf * (tf * (BM25_K1 + 1)) / (tf + BM25_K1 * (1 - BM25_B + BM25_B * normLen));
+}
+
 void split(const char* sentence, vector<string_view>& result) {
     const char* it = sentence;
     while (*it != 0) {
@@ -92,11 +165,13 @@ void split(const char* sentence, vector<string_view>& result) {
  * 
  * Instead of copying the whole map, we just copy the frequency which is stored in a separate array
  * @returns a pointer to the frequency table, and its size
- * @note ptr to ptr+size is the table, ptr+size to ptr+size*2 is a copy of this table
+ * @note ptr to ptr+size is the table, ptr+size to ptr+size*2 is a copy of this table.
+ * It is allocated from the scratch arena
 */
 inline pair<int16_t*, int> constructQueryGrams(GramMap& queryGrams, string_view query, int gramLen) {
     int queryGramCount = query.size() - gramLen + 1;
-    auto* freqCount = new int16_t[queryGramCount * 2]();
+    auto* freqCount = Arena::allocArray<int16_t>(queryGramCount * 2);
+    memset(freqCount, 0, queryGramCount * 2 * sizeof(int16_t));
     auto* curPtr = freqCount;
     for (int j = 0; j < queryGramCount; j++) {
         auto& ptr = queryGrams[query.substr(j, gramLen)];
@@ -149,6 +224,133 @@ inline void addMatchNoOverlap(vector<Match>& matches, int start, int end) {
     }
 }
 
+/**
+ * tokens are ranked for autocomplete by their popularity, i.e. the number of sentences containing them
+ */
+inline bool morePopular(const FastSearcher* searcher, int a, int b) {
+    auto sa = searcher->uniqueTokens[a].postings.size(), sb = searcher->uniqueTokens[b].postings.size();
+    return sa == sb ? a < b : sa > sb;
+}
+
+/**
+ * a sentence suggested for a prefix, together with the most popular completion of the prefix it contains
+ */
+struct Suggestion {
+    int token, sentence;
+};
+
+/**
+ * sentences are ranked for autocomplete by the popularity of the most popular completion they contain,
+ * and then by their indices
+ */
+inline bool betterSuggestion(const FastSearcher* searcher, const Suggestion& a, const Suggestion& b) {
+    return a.token == b.token ? a.sentence < b.sentence : morePopular(searcher, a.token, b.token);
+}
+
+/**
+ * append the first AUTOCOMPLETE_K sentences containing the token to the suggestions
+ */
+void addSuggestions(const FastSearcher* searcher, int token, vector<Suggestion>& suggestions) {
+    const auto& postings = searcher->uniqueTokens[token].postings;
+    for (int i = 0; i < (int)postings.size() && i < AUTOCOMPLETE_K; i++) suggestions.push_back({token, postings[i].sentence});
+}
+
+/**
+ * recursively build the subtree of the prefix trie rooted at `node`,
+ * whose tokens are sortedTokens[lo, hi) that share a common prefix of length `depth`
+ * @returns the top AUTOCOMPLETE_K sentences of the node in order. A sentence among them is ranked at the same place
+ * among the sentences of the child containing its most popular completion, so they are merged from those of the children
+ */
+vector<Suggestion> buildTrie(FastSearcher* searcher, int node, int lo, int hi, int depth) {
+    auto& sorted = searcher->sortedTokens;
+    auto tokenAt = [searcher, &sorted](int i) { return searcher->uniqueTokens[sorted[i]].token; };
+
+    searcher->trie[node] = {lo, hi, (int)searcher->trieChars.size(), 0, -1};
+    if (hi - lo > AUTOCOMPLETE_K) {
+        auto& top = searcher->topTokens;
+        int offset = top.size();
+        top.insert(top.end(), sorted.begin() + lo, sorted.begin() + hi);
+        partial_sort(top.begin() + offset, top.begin() + offset + AUTOCOMPLETE_K, top.end(),
+                     [searcher](int a, int b) { return morePopular(searcher, a, b); });
+        top.resize(offset + AUTOCOMPLETE_K);
+        // the sentences are filled after the children are built
+        searcher->topSentences.resize(offset + AUTOCOMPLETE_K, -1);
+        searcher->trie[node].topOffset = offset;
+    }
+
+    // the token equal to the prefix itself (if any) comes first and has no child
+    vector<Suggestion> suggestions;
+    int start = lo;
+    if (start < hi && (int)tokenAt(start).size() == depth) addSuggestions(searcher, sorted[start++], suggestions);
+
+    // allocate the edges and children first so that the children of a node are contiguous
+    vector<int> bounds;
+    for (int i = start; i < hi; i++) {
+        if (i == start || tokenAt(i)[depth] != tokenAt(i - 1)[depth]) {
+            bounds.push_back(i);
+            searcher->trieChars.push_back((uint8_t)tokenAt(i)[depth]);
+            searcher->trieChildren.push_back(searcher->trie.size());
+            searcher->trie.emplace_back();
+        }
+    }
+    bounds.push_back(hi);
+    int numEdges = bounds.size() - 1;
+    int firstEdge = searcher->trie[node].firstEdge;
+    searcher->trie[node].numEdges = numEdges;
+    for (int i = 0; i < numEdges; i++) {
+        auto child = buildTrie(searcher, searcher->trieChildren[firstEdge + i], bounds[i], bounds[i + 1], depth + 1);
+        suggestions.insert(suggestions.end(), child.begin(), child.end());
+    }
+
+    // keep the best suggestion of each sentence
+    sort(suggestions.begin(), suggestions.end(), [searcher](const Suggestion& a, const Suggestion& b) { return betterSuggestion(searcher, a, b); });
+    int numSuggestions = 0;
+    for (const auto& suggestion : suggestions) {
+        if (numSuggestions == AUTOCOMPLETE_K) break;
+        auto end = suggestions.begin() + numSuggestions;
+        if (find_if(suggestions.begin(), end, [&](const Suggestion& x) { return x.sentence == suggestion.sentence; }) == end)
+            suggestions[numSuggestions++] = suggestion;
+    }
+    suggestions.resize(numSuggestions);
+    int offset = searcher->trie[node].topOffset;
+    for (int i = 0; offset >= 0 && i < numSuggestions; i++) searcher->topSentences[offset + i] = suggestions[i].sentence;
+    return suggestions;
+}
+
+/**
+ * estimate the number of bytes held by a searcher
+ */
+uint32_t computeMemSize(const FastSearcher* searcher) {
+    uint32_t size = sizeof(FastSearcher) + searcher->size * (sizeof(Sentence) + sizeof(int));
+    for (int i = 0; i < searcher->size; i++) {
+        const auto& sentence = searcher->sentences[i];
+        size += sentence.original.size() + 1 + sentence.tokens.capacity() * sizeof(IndexedToken);
+    }
+    for (const auto& token : searcher->uniqueTokens)
+        size += sizeof(Token) + token.postings.capacity() * sizeof(Posting);
+    size += searcher->str2num.bucket_count() * (sizeof(pair<string_view, int>) + 1);
+    size += searcher->sortedTokens.capacity() * sizeof(int) + searcher->trie.capacity() * sizeof(TrieNode) +
+            searcher->trieChars.capacity() + searcher->trieChildren.capacity() * sizeof(int) +
+            (searcher->topTokens.capacity() + searcher->topSentences.capacity()) * sizeof(int);
+    return size;
+}
+
+/**
+ * buffer for the results of autocomplete: [number of tokens, number of sentences, token indices..., sentence indices...]
+ */
+vector<int> autocompleteBuffer;
+/**
+ * buffer for a NULL-terminated copy of a token
+ */
+string tokenBuffer;
+
+void releaseMemory(int flags) {
+    if (!(flags & MemoryStats::releaseSearcher)) return;
+    splitBuffer = vector<string_view>();
+    autocompleteBuffer = vector<int>();
+    tokenBuffer = string();
+}
+
 extern "C" {
 
 /**
@@ -157,6 +359,7 @@ extern "C" {
  * @param N ths length of sentences
 */
 FastSearcher* getSearcher(const char** sentences, int N) {
+    TRACE_SPAN("Searcher::getSearcher");
     auto* searcher = new FastSearcher();
     searcher->size = N;
     searcher->indices = new int[N];
@@ -164,8 +367,8 @@ FastSearcher* getSearcher(const char** sentences, int N) {
     auto& uniqueTokens = searcher->uniqueTokens;
 
     int maxTokenLen = 0;
-    // map a token to an index in the uniqueTokens array
-    HashMap<string_view, int> str2num(N * 2);
+    auto& str2num = searcher->str2num;
+    str2num.reserve(N * 2);
     for (int i = 0; i < N; i++) {
         const char* sentence = searcher->sentences[i]._original = sentences[i];
         const char* it = sentence;
@@ -180,6 +383,12 @@ FastSearcher* getSearcher(const char** sentences, int N) {
                 uniqueTokens.push_back({token, 0.0f});
             // record the position of this token in the unique token list
             searcher->sentences[i].tokens.push_back({{mit->second}, static_cast<int>(tokenStart - sentence)});
+            // update the postings list of this token
+            auto& postings = uniqueTokens[mit->second].postings;
+            if (postings.size() && postings.back().sentence == i)
+                postings.back().tf++;
+            else
+                postings.push_back({i, 1});
             // skip spaces
             while (*it == ' ' && *it != 0) it++;
         }
@@ -191,6 +400,20 @@ FastSearcher* getSearcher(const char** sentences, int N) {
     uniqueTokens.shrink_to_fit();
     searcher->scoreWindow = new float[maxTokenLen];
 
+    // pre-compute the statistics needed by bm25Search
+    long long totalLen = 0;
+    for (int i = 0; i < N; i++) totalLen += searcher->sentences[i].tokens.size();
+    float avgLen = N ? max(static_cast<float>(totalLen) / N, 1.0f) : 1.0f;
+    for (int i = 0; i < N; i++) searcher->sentences[i].normLen = searcher->sentences[i].tokens.size() / avgLen;
+    for (auto& token : uniqueTokens) {
+        token.postings.shrink_to_fit();
+        float df = token.postings.size();
+        token.idf = log(1.0f + (N - df + 0.5f) / (df + 0.5f));
+        token.maxImpact = 0.0f;
+        for (auto [sentence, tf] : token.postings)
+            token.maxImpact = max(token.maxImpact, bm25Impact(token.idf, tf, searcher->sentences[sentence].normLen));
+    }
+
     // note: we can only assign pointers into uniqueTokens here (no reallocations will occur after this point)
     // otherwise they might be invalid
     for (int i = 0; i < N; i++) {
@@ -198,7 +421,18 @@ FastSearcher* getSearcher(const char** sentences, int N) {
             token.token = &uniqueTokens[token.idx];
         }
     }
+
+    // build the prefix trie used by autocomplete
+    auto& sorted = searcher->sortedTokens;
+    sorted.resize(uniqueTokens.size());
+    for (int i = 0; i < (int)sorted.size(); i++) sorted[i] = i;
+    sort(sorted.begin(), sorted.end(), [&uniqueTokens](int a, int b) { return uniqueTokens[a].token < uniqueTokens[b].token; });
+    searcher->trie.emplace_back();
+    buildTrie(searcher, 0, 0, sorted.size(), 0);
+    searcher->memSize = computeMemSize(searcher);
+    MemoryStats::track(MemoryStats::searcherIndex, searcher->memSize);
 #ifdef DEBUG_LOG
+    cout << "trie nodes: " << searcher->trie.size() << " | top token entries: " << searcher->topTokens.size() << endl;
     int numTokens = 0;
     for (int i = 0; i < N; i++) {
         numTokens += searcher->sentences[i].tokens.size();
@@ -214,6 +448,8 @@ FastSearcher* getSearcher(const char** sentences, int N) {
  * @param _query a dynamically allocated string. It will be freed before this function returns.
  */
 int findBestMatch(FastSearcher* searcher, const char* _query) {
+    TRACE_SPAN("Searcher::findBestMatch");
+    Arena::Scope scope;
     string_view query(_query);
     GramMap queryGrams;
     auto [freqCount, queryGramCount] = constructQueryGrams(queryGrams, query, 2);
@@ -230,7 +466,6 @@ int findBestMatch(FastSearcher* searcher, const char* _query) {
     }
     searcher->sentences[bestMatchIndex].score = bestMatchRating;
     free((void*)_query);
-    delete[] freqCount;
     return bestMatchIndex;
 }
 
@@ -239,6 +474,8 @@ int findBestMatch(FastSearcher* searcher, const char* _query) {
  * @param _query a dynamically allocated string. It will be freed after this function returns.
 */
 int* sWSearch(FastSearcher* searcher, const char* _query, const int numResults, const int gramLen, const float threshold) {
+    TRACE_SPAN("Searcher::sWSearch");
+    Arena::Scope scope;
     string_view query(_query);
     splitBuffer.resize(0);
     split(_query, splitBuffer);
@@ -274,7 +511,6 @@ int* sWSearch(FastSearcher* searcher, const char* _query, const int numResults,
             // restore frequency table to its original state
             memcpy(freqCount, freqCount + queryGramCount, queryGramCount * sizeof(int16_t));
         }
-        delete[] freqCount;
     }
 
     len = searcher->size;
@@ -338,6 +574,190 @@ int* sWSearch(FastSearcher* searcher, const char* _query, const int numResults,
     return searcher->indices;
 }
 
+/**
+ * ranked retrieval using BM25 on exact token matches.
+ * Evaluated document-at-a-time with MaxScore early termination,
+ * so postings of the terms that cannot lift a sentence into the top results are only partially read
+ * @param _query a dynamically allocated string. It will be freed before this function returns.
+ * @returns the array of indices of the matched sentences, sorted by descending score.
+ * Its length is given by getNumResults
+ */
+int* bm25Search(FastSearcher* searcher, const char* _query, const int numResults) {
+    TRACE_SPAN("Searcher::bm25Search");
+    Arena::Scope scope;
+    splitBuffer.resize(0);
+    split(_query, splitBuffer);
+
+    // the query terms found in the dictionary, sorted by ascending upper bound
+    Arena::ScratchVector<const Token*> terms;
+    for (auto word : splitBuffer) {
+        auto it = searcher->str2num.find(word);
+        if (it == searcher->str2num.end()) continue;
+        const auto* token = &searcher->uniqueTokens[it->second];
+        if (find(terms.begin(), terms.end(), token) == terms.end()) terms.push_back(token);
+    }
+    sort(terms.begin(), terms.end(), [](const Token* a, const Token* b) { return a->maxImpact < b->maxImpact; });
+
+    const int numTerms = terms.size();
+    // prefix sums of the upper bounds: sum of maxImpact of terms[0] to terms[i] inclusive
+    Arena::ScratchVector<float> ubPrefix(numTerms);
+    Arena::ScratchVector<int> cursors(numTerms, 0);
+    for (int i = 0; i < numTerms; i++)
+        ubPrefix[i] = terms[i]->maxImpact + (i ? ubPrefix[i - 1] : 0.0f);
+
+    // min heap of (score, sentence), holding the best results found so far
+    auto cmp = [](const pair<float, int>& a, const pair<float, int>& b) { return a.first > b.first; };
+    Arena::ScratchVector<pair<float, int>> heap;
+    float threshold = 0.0f;
+    // terms[0] to terms[firstEssential - 1] are non-essential: they cannot make a sentence enter the heap alone
+    int firstEssential = 0;
+#if defined(DEBUG_LOG) || defined(ENABLE_TRACE)
+    int postingsRead = 0;
+#endif
+    while (numResults > 0 && firstEssential < numTerms) {
+        // the next candidate is the smallest sentence index among the essential terms
+        int sentence = INT32_MAX;
+        for (int i = firstEssential; i < numTerms; i++) {
+            const auto& postings = terms[i]->postings;
+            if (cursors[i] < (int)postings.size()) sentence = min(sentence, postings[cursors[i]].sentence);
+        }
+        if (sentence == INT32_MAX) break;
+
+        float normLen = searcher->sentences[sentence].normLen;
+        float score = 0.0f;
+        for (int i = firstEssential; i < numTerms; i++) {
+            const auto& postings = terms[i]->postings;
+            if (cursors[i] < (int)postings.size() && postings[cursors[i]].sentence == sentence) {
+                score += bm25Impact(terms[i]->idf, postings[cursors[i]].tf, normLen);
+                cursors[i]++;
+#if defined(DEBUG_LOG) || defined(ENABLE_TRACE)
+                postingsRead++;
+#endif
+            }
+        }
+        // probe the non-essential terms, from the most to the least important,
+        // stopping as soon as the candidate cannot beat the threshold
+        for (int i = firstEssential - 1; i >= 0; i--) {
+            if ((int)heap.size() == numResults && score + ubPrefix[i] <= threshold) break;
+            const auto& postings = terms[i]->postings;
+            auto it = lower_bound(postings.begin() + cursors[i], postings.end(), sentence,
+                                  [](const Posting& p, int s) { return p.sentence < s; });
+            cursors[i] = it - postings.begin();
+            if (it != postings.end() && it->sentence == sentence) {
+                score += bm25Impact(terms[i]->idf, it->tf, normLen);
+#if defined(DEBUG_LOG) || defined(ENABLE_TRACE)
+                postingsRead++;
+#endif
+            }
+        }
+
+        if ((int)heap.size() < numResults) {
+            heap.push_back({score, sentence});
+            push_heap(heap.begin(), heap.end(), cmp);
+        } else if (score > threshold) {
+            pop_heap(heap.begin(), heap.end(), cmp);
+            heap.back() = {score, sentence};
+            push_heap(heap.begin(), heap.end(), cmp);
+        } else {
+            continue;
+        }
+        if ((int)heap.size() == numResults) {
+            threshold = heap.front().first;
+            while (firstEssential < numTerms && ubPrefix[firstEssential] <= threshold) firstEssential++;
+        }
+    }
+#ifdef DEBUG_LOG
+    int totalPostings = 0;
+    for (auto term : terms) totalPostings += term->postings.size();
+    cout << "bm25: read " << postingsRead << " of " << totalPostings << " postings" << endl;
+#endif
+    TRACE_COUNTER("Searcher::postingsRead", postingsRead);
+
+    sort_heap(heap.begin(), heap.end(), cmp);
+    searcher->numResults = heap.size();
+    for (int i = 0; i < searcher->numResults; i++) {
+        auto [score, idx] = heap[i];
+        auto& sentence = searcher->sentences[idx];
+        searcher->indices[i] = idx;
+        sentence.score = score;
+        // highlight the query terms occurring in this sentence
+        sentence.matches.resize(0);
+        for (auto& token : sentence.tokens) {
+            if (find(terms.begin(), terms.end(), token.token) != terms.end())
+                addMatchNoOverlap(sentence.matches, token.index, token.index + token.token->token.size());
+        }
+    }
+    free((void*)_query);
+    return searcher->indices;
+}
+
+int getNumResults(const FastSearcher* searcher) {
+    return searcher->numResults;
+}
+
+/**
+ * prefix autocomplete over the tokens, independent of the number of sentences
+ * @param _prefix a dynamically allocated, lower-cased string. It will be freed before this function returns.
+ * @returns pointer to the results: [number of tokens (n), number of sentences (m), n token indices, m sentence indices].
+ * Tokens are the most popular completions of the prefix, and sentences are ranked by the most popular completion
+ * they contain (see betterSuggestion)
+ */
+const int* autocomplete(const FastSearcher* searcher, const char* _prefix) {
+    TRACE_SPAN("Searcher::autocomplete");
+    string_view prefix(_prefix);
+    auto& result = autocompleteBuffer;
+    result.assign(2, 0);
+
+    // walk down the trie, one character at a time
+    int node = 0;
+    for (uint8_t c : prefix) {
+        const auto& cur = searcher->trie[node];
+        auto begin = searcher->trieChars.begin() + cur.firstEdge,
+             end = begin + cur.numEdges;
+        auto it = lower_bound(begin, end, c);
+        if (it == end || *it != c) {
+            free((void*)_prefix);
+            return result.data();
+        }
+        node = searcher->trieChildren[it - searcher->trieChars.begin()];
+    }
+    free((void*)_prefix);
+
+    const auto& cur = searcher->trie[node];
+    if (cur.topOffset >= 0) {
+        auto start = searcher->topTokens.begin() + cur.topOffset;
+        result.insert(result.end(), start, start + AUTOCOMPLETE_K);
+        result[0] = AUTOCOMPLETE_K;
+        for (auto it = searcher->topSentences.begin() + cur.topOffset; result[1] < AUTOCOMPLETE_K && *it >= 0; it++) {
+            result.push_back(*it);
+            result[1]++;
+        }
+        return result.data();
+    }
+    result.insert(result.end(), searcher->sortedTokens.begin() + cur.lo, searcher->sortedTokens.begin() + cur.hi);
+    sort(result.begin() + 2, result.end(), [searcher](int a, int b) { return morePopular(searcher, a, b); });
+    int numTokens = result[0] = result.size() - 2;
+
+    // there are at most AUTOCOMPLETE_K completions, so the sentences are ranked directly: the sentences of each completion
+    // in the order of the completions, each at its first (i.e. most popular) completion
+    for (int i = 0; i < numTokens && result[1] < AUTOCOMPLETE_K; i++) {
+        for (auto [sentence, _] : searcher->uniqueTokens[result[2 + i]].postings) {
+            if (find(result.begin() + 2 + numTokens, result.end(), sentence) != result.end()) continue;
+            result.push_back(sentence);
+            if (++result[1] == AUTOCOMPLETE_K) break;
+        }
+    }
+    return result.data();
+}
+
+/**
+ * @returns a NULL-terminated copy of the token at idx of the unique tokens. It is valid until the next call
+ */
+const char* getToken(const FastSearcher* searcher, int idx) {
+    tokenBuffer = searcher->uniqueTokens[idx].token;
+    return tokenBuffer.c_str();
+}
+
 const Match* getMatches(const FastSearcher* searcher, int idx) {
     return searcher->sentences[idx].matches.data();
 }
@@ -349,6 +769,7 @@ float getScore(const FastSearcher* searcher, int idx) {
 }
 
 void deleteSearcher(FastSearcher* searcher) {
+    MemoryStats::track(MemoryStats::searcherIndex, -(int64_t)searcher->memSize);
     delete[] searcher->sentences;
     delete[] searcher->indices;
     delete[] searcher->scoreWindow;
@@ -86,6 +86,67 @@ export class FastSearcher<T, K = string> {
         return allMatches;
     }
 
+    /**
+     * ranked retrieval: score the items containing the exact words of the query using BM25,
+     * so rare words weigh more than common ones (e.g. "introduction")
+     * @param query
+     * @param numResults the maximum number of results to return
+     */
+    public bm25Search(query: string, numResults: number) {
+        const Module = window.NativeModule;
+        const ptr = prepareQuery(Module, query, 1);
+        const allMatches: SearchResult<T, K>[] = [];
+        if (ptr === -1) return allMatches;
+
+        const resultPtr = Module._bm25Search(this.ptr, ptr, numResults) / 4;
+        const total = Module._getNumResults(this.ptr);
+        const idxArr = Module.HEAP32.subarray(resultPtr, resultPtr + total);
+        for (let i = 0; i < total; i++) {
+            const idx = idxArr[i];
+            const matchPtr = Module._getMatches(this.ptr, idx) / 4;
+            allMatches.push({
+                score: Module._getScore(this.ptr, idx),
+                index: idx,
+                data: this.data,
+                matches: Module.HEAP32.subarray(
+                    matchPtr,
+                    matchPtr + Module._getMatchSize(this.ptr, idx) * 2
+                )
+            });
+        }
+        return allMatches;
+    }
+
+    /**
+     * prefix autocomplete of the last word in the query
+     * @param query
+     * @returns the most popular words completing the last word of the query,
+     * and the indices of the items containing them
+     */
+    public autocomplete(query: string) {
+        const Module = window.NativeModule;
+        const words = query
+            .trim()
+            .toLowerCase()
+            .split(/\s+/);
+        const ptr = allocateStr(Module, words[words.length - 1]);
+
+        const resultPtr = Module._autocomplete(this.ptr, ptr) / 4;
+        const numTokens = Module.HEAP32[resultPtr],
+            numItems = Module.HEAP32[resultPtr + 1];
+        const completions: string[] = [];
+        for (let i = 0; i < numTokens; i++) {
+            completions.push(
+                Module.UTF8ToString(Module._getToken(this.ptr, Module.HEAP32[resultPtr + 2 + i]))
+            );
+        }
+        const itemStart = resultPtr + 2 + numTokens;
+        return {
+            completions,
+            indices: Array.from(Module.HEAP32.subarray(itemStart, itemStart + numItems))
+        };
+    }
+
     /**
      * @param query
      * @returns [best match index, score of the best match]
@@ -0,0 +1,19 @@
+/**
+ * GLPK is not linked into the main native module. It is built into a side module (glpk.wasm, see the Makefile),
+ * which is loaded by `loadSolver` (see Solver.ts) when a model that needs it is first requested,
+ * so that the generator and the default layout do not pay for downloading and compiling it.
+ *
+ * The code calling GLPK must check `Solver::available` first and fall back to a method without it.
+ * In builds that link GLPK statically (without LAZY_GLPK), it is always available.
+ */
+#pragma once
+
+namespace Solver {
+
+#ifdef LAZY_GLPK
+inline bool available = false;
+#else
+inline bool available = true;
+#endif
+
+}  // namespace Solver
@@ -0,0 +1,53 @@
+/**
+ * loader of the LP/MILP solver (GLPK), which is built into a side module separate from the main native module.
+ * It is only needed by the optional layout models of the renderer and by the optimal generation,
+ * so it is fetched on first use instead of at startup
+ * @module src/algorithm
+ */
+
+import { traceEnd, traceStart } from './Trace';
+
+/**
+ * the path of the side module, relative to the page. It is built to `temp/glpk.wasm` by the Makefile,
+ * and then deployed to public/js along with wasm_modules.js by scripts/build_wasm.sh
+ */
+const SIDE_MODULE = 'js/glpk.wasm';
+
+let pending: Promise<boolean> | null = null;
+let loaded = false;
+
+/**
+ * @returns whether the solver is loaded into the native module, in which case the models using it are available
+ */
+export function solverLoaded() {
+    return loaded;
+}
+
+/**
+ * load the solver into the native module, at most once. Until it is loaded, the native module falls back to the
+ * models that do not need it (see `Solver::available` in Solver.hpp)
+ * @returns a promise resolved to whether the solver is available
+ */
+export function loadSolver(): Promise<boolean> {
+    if (pending) return pending;
+    const Module = window.NativeModule;
+    // statically linked (e.g. the test build), so the solver is already there
+    if (!Module.loadDynamicLibrary) {
+        loaded = true;
+        return (pending = Promise.resolve(true));
+    }
+    const start = traceStart();
+    pending = Module.loadDynamicLibrary(SIDE_MODULE, { loadAsync: true, global: true, nodelete: true })
+        .then(() => {
+            Module._setSolverAvailable();
+            traceEnd('Solver.load', start);
+            return (loaded = true);
+        })
+        .catch(err => {
+            console.error('failed to load the solver', err);
+            // allow retrying on the next use
+            pending = null;
+            return false;
+        });
+    return pending;
+}
@@ -0,0 +1,72 @@
+#include "Trace.hpp"
+
+#include <string>
+
+using namespace std;
+
+namespace Trace {
+
+/**
+ * backing storage of the JSON returned by dumpTrace
+ */
+string traceJSON;
+
+extern "C" {
+
+/**
+ * dump the events currently in the ring buffer as Chrome trace-event JSON
+ * @returns a NULL-terminated JSON string. It is valid until the next call of this function
+ */
+const char* dumpTrace() {
+    traceJSON = "{\"traceEvents\":[";
+#ifdef ENABLE_TRACE
+    unsigned int start = numEvents > BUFFER_SIZE ? numEvents - BUFFER_SIZE : 0;
+    for (unsigned int i = start; i < numEvents; i++) {
+        const auto& event = events[i % BUFFER_SIZE];
+        if (i != start) traceJSON += ',';
+        traceJSON += "{\"name\":\"";
+        traceJSON += event.name;
+        traceJSON += "\",\"ph\":\"";
+        traceJSON += event.phase;
+        traceJSON += "\",\"pid\":1,\"tid\":1,\"ts\":";
+        traceJSON += to_string(event.ts);
+        if (event.phase == 'X') {
+            traceJSON += ",\"dur\":";
+            traceJSON += to_string(event.value);
+        } else {
+            traceJSON += ",\"args\":{\"value\":";
+            traceJSON += to_string(event.value);
+            traceJSON += '}';
+        }
+        traceJSON += '}';
+    }
+#endif
+    traceJSON += "]}";
+    return traceJSON.c_str();
+}
+
+/**
+ * @returns the current time of the clock of the trace in microseconds, used to record the spans of the TS wrappers
+ * (see Trace.ts). Returns -1 if tracing is disabled
+ */
+double traceNow() {
+#ifdef ENABLE_TRACE
+    return now();
+#else
+    return -1.0;
+#endif
+}
+
+/**
+ * discard all recorded events
+ */
+void clearTrace() {
+#ifdef ENABLE_TRACE
+    numEvents = 0;
+#endif
+    traceJSON.clear();
+    traceJSON.shrink_to_fit();
+}
+}
+
+}  // namespace Trace
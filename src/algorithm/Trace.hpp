@@ -0,0 +1,69 @@
+/**
+ * A lightweight tracing facility shared by the native modules (ScheduleGenerator, Renderer and Searcher).
+ *
+ * Named spans and counters are recorded into a fixed-size ring buffer (older events are overwritten),
+ * which can be exported as Chrome trace-event JSON using `dumpTrace` (see Trace.cpp)
+ * and loaded into chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Everything here compiles to nothing unless ENABLE_TRACE is defined.
+ */
+#pragma once
+
+#ifdef ENABLE_TRACE
+
+#include <chrono>
+
+namespace Trace {
+
+struct Event {
+    /** name of the span/counter. Must be a string literal (or have static storage duration) */
+    const char* name;
+    /** 'X' for a complete span, 'C' for a counter */
+    char phase;
+    /** start time of the event in microseconds */
+    double ts;
+    /** duration of a span in microseconds, or the value of a counter */
+    double value;
+};
+
+constexpr unsigned int BUFFER_SIZE = 1 << 15;
+
+inline Event events[BUFFER_SIZE];
+/** total number of events recorded so far. The latest event is at events[(numEvents - 1) % BUFFER_SIZE] */
+inline unsigned int numEvents = 0;
+
+inline double now() {
+    return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+inline void record(const char* name, char phase, double ts, double value) {
+    events[numEvents++ % BUFFER_SIZE] = {name, phase, ts, value};
+}
+
+/**
+ * RAII span: records a complete event from construction to destruction
+ */
+struct Span {
+    const char* name;
+    double start;
+    explicit Span(const char* _name) : name(_name), start(now()) {}
+    ~Span() {
+        record(name, 'X', start, now() - start);
+    }
+};
+
+}  // namespace Trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+/** trace the enclosing scope as a span with the given name */
+#define TRACE_SPAN(name) Trace::Span TRACE_CONCAT(__traceSpan, __LINE__)(name)
+/** record the value of a counter at the current time */
+#define TRACE_COUNTER(name, value) Trace::record(name, 'C', Trace::now(), static_cast<double>(value))
+
+#else
+
+#define TRACE_SPAN(name)
+#define TRACE_COUNTER(name, value)
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @module src/algorithm
+ * @author Hanzhi Zhou
+ */
+
+/**
+ * a complete span recorded by the TS wrappers, in the format of the Chrome trace events
+ */
+interface Span {
+    name: string;
+    ph: 'X';
+    pid: number;
+    tid: number;
+    ts: number;
+    dur: number;
+}
+
+/** maximum number of spans of the TS wrappers kept. Older spans are overwritten, like the native ones */
+const MAX_SPANS = 1 << 12;
+const spans: Span[] = [];
+/** total number of spans recorded so far */
+let numSpans = 0;
+
+/**
+ * start a span of the TS wrappers, which is timed by the same clock as the native spans
+ * @returns the start time to be passed to [[traceEnd]], or -1 if the native module is built without ENABLE_TRACE
+ */
+export function traceStart(): number {
+    return window.NativeModule._traceNow();
+}
+
+/**
+ * end a span started by [[traceStart]] and record it along with the native spans. Nothing is recorded if tracing is disabled
+ * @param name the name of the span
+ * @param start the return value of [[traceStart]]
+ */
+export function traceEnd(name: string, start: number) {
+    if (start < 0) return;
+    const dur = window.NativeModule._traceNow() - start;
+    spans[numSpans++ % MAX_SPANS] = { name, ph: 'X', pid: 1, tid: 1, ts: start, dur };
+}
+
+/**
+ * get the spans and counters recorded by the native modules and the TS wrappers as a Chrome trace-event object,
+ * which can be saved as a .json file and loaded into chrome://tracing or https://ui.perfetto.dev
+ * @note the trace is empty unless the wasm module is built with ENABLE_TRACE (`make dev` or `make prod TRACE=1`)
+ */
+export function dumpNativeTrace(): { traceEvents: object[] } {
+    const Module = window.NativeModule;
+    const trace = JSON.parse(Module.UTF8ToString(Module._dumpTrace()));
+    trace.traceEvents.push(...spans);
+    return trace;
+}
+
+/**
+ * discard all the events recorded by the native modules and the TS wrappers
+ */
+export function clearNativeTrace() {
+    window.NativeModule._clearTrace();
+    spans.length = 0;
+    numSpans = 0;
+}
+
+// expose to the console for profiling user sessions
+(window as any).dumpNativeTrace = dumpNativeTrace;
+(window as any).clearNativeTrace = clearNativeTrace;
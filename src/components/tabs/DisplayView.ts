@@ -5,7 +5,7 @@
 /**
  *
  */
-import { options } from '@/algorithm/Renderer';
+import { options, layoutLevels, layoutStats } from '@/algorithm/Renderer';
 import CatalogDB from '@/data/CatalogDB';
 import Store from '@/store';
 import { Component, Watch } from 'vue-property-decorator';
@@ -19,6 +19,8 @@ import { Component, Watch } from 'vue-property-decorator';
 @Component
 export default class DisplayView extends Store {
     options = options;
+    layoutLevels = layoutLevels;
+    layoutStats = layoutStats;
     showRenderingOptions = process.env.NODE_ENV === 'development';
     @Watch('options', { deep: true }) private w1() {
         this.schedule.recomputeAll(false, 100);
@@ -26,6 +26,23 @@ export default class FilterView extends Store {
         return DAYS;
     }
 
+    /**
+     * the keys and display names of the courses in the current schedule, which can be marked as optional
+     */
+    get cartCourses() {
+        return Object.keys(this.schedule.proposedSchedule.All).map(key => {
+            const course = window.catalog && window.catalog.getCourse(key);
+            return { key, name: course ? course.displayName : key };
+        });
+    }
+
+    toggleOptional(key: string) {
+        const keys = this.filter.optionalCourses;
+        const idx = keys.indexOf(key);
+        if (idx === -1) keys.push(key);
+        else keys.splice(idx, 1);
+    }
+
     dragEnd() {
         if (this.filter.sortOptions.mode === 0) this.changeSorting();
     }
@@ -70,16 +87,27 @@ export default class FilterView extends Store {
     }
 
     applySort() {
-        if (!window.scheduleEvaluator.empty()) {
-            window.scheduleEvaluator.sort({ newOptions: this.filter.sortOptions });
-            if (!this.schedule.generated) {
-                this.schedule.switchSchedule(true);
-            } else {
-                // re-assign the current schedule
-                this.schedule.currentSchedule = window.scheduleEvaluator.getSchedule(
-                    this.schedule.currentScheduleIndex
-                );
-            }
+        const evaluator = window.scheduleEvaluator;
+        if (!evaluator.empty()) {
+            // large results show an approximate order first, then the exact one when it is ready
+            evaluator.sort({
+                newOptions: this.filter.sortOptions,
+                onExact: () => {
+                    if (window.scheduleEvaluator === evaluator) this.showSorted();
+                }
+            });
+            this.showSorted();
+        }
+    }
+
+    showSorted() {
+        if (!this.schedule.generated) {
+            this.schedule.switchSchedule(true);
+        } else {
+            // re-assign the current schedule
+            this.schedule.currentSchedule = window.scheduleEvaluator.getSchedule(
+                this.schedule.currentScheduleIndex
+            );
         }
     }
 }
@@ -17,11 +17,19 @@ export interface CourseTableItem extends CourseFields {
 }
 // no back ref in db
 export type SectionTableItem = Omit<SectionFields, 'course'>;
+/** binary data derived from the catalog, e.g. the conflict index */
+export interface BlobTableItem {
+    key: string;
+    /** the modification time of the catalog it is derived from */
+    time: number;
+    data: Uint8Array;
+}
 
 export default class CatalogDB extends Dexie {
     courses: Dexie.Table<CourseTableItem, string>;
     sections: Dexie.Table<SectionTableItem, number>;
     meta: Dexie.Table<{ time: number; id: 0 }, 0>;
+    blobs: Dexie.Table<BlobTableItem, string>;
 
     constructor(semester: SemesterJSON) {
         super(`db_${semester.id}`);
@@ -30,9 +38,16 @@ export default class CatalogDB extends Dexie {
             sections: 'id',
             meta: 'id'
         });
+        this.version(2).stores({
+            courses: 'key',
+            sections: 'id',
+            meta: 'id',
+            blobs: 'key'
+        });
         this.courses = this.table('courses');
         this.sections = this.table('sections');
         this.meta = this.table('meta');
+        this.blobs = this.table('blobs');
     }
 
     async empty() {
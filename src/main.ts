@@ -12,6 +12,7 @@ import ScheduleEvaluator from './algorithm/ScheduleEvaluator';
 import Catalog from './models/Catalog';
 import { highlightMatch } from './utils';
 import { FastSearcher } from './algorithm/Searcher';
+import './algorithm/Trace';
 import App from './App.vue';
 import axios from 'axios';
 import WatchFactory from './store/watch';
@@ -28,24 +29,47 @@ declare global {
     // ! for parameter meaning, refer to the cpp files in src/algorithm
     interface EMModule {
         _malloc(size: number): Ptr;
+        _free(ptr: Ptr): void;
 
         // ------------ APIs of Renderer.cpp --------------------------------------
         _setOptions(...a: number[]): void;
         _getSum(): number;
         _getSumSq(): number;
+        _getLevel(): number;
+        _setSolverAvailable(): void;
         _compute(a: Ptr, b: number): Ptr;
         // ------------------------------------------------------------------------
 
         // ------------ APIs of ScheduleGenerator.cpp -----------------------------
-        _generate(a: number, b: number, c: Ptr, d: Ptr, e: Ptr): number;
+        _generate(a: number, b: number, c: Ptr, d: Ptr, e: Ptr, f: Ptr): number;
         _setSortOption: any;
         _setSortMode(a: number): void;
         _sort(): void;
+        _sortPreview(a: number): number;
+        _sortStep(a: number): boolean;
         _size(): number;
         _setTimeMatrix(a: Ptr, b: number): void;
         _getSchedule(a: number): Ptr;
+        _getPrunedSections(): Ptr;
+        _getTotalCount(): number;
+        _getSectionCounts(): Ptr;
+        _setSampling(a: number): void;
+        _setSearchBudget(a: number): void;
+        _setEvalLayout(a: number): void;
+        _setSectionCosts(a: Ptr, b: number): void;
+        _setOptionalCourses(a: Ptr, b: number, c: number): void;
+        _setSectionIds(a: Ptr): void;
+        _buildCatalogIndex(a: number, b: Ptr, c: Ptr, d: Ptr, e: Ptr): void;
+        _gatherSections(a: number, b: Ptr, c: Ptr): Ptr;
+        _exportCatalogIndex(): Ptr;
+        _loadCatalogIndex(a: Ptr): boolean;
+        _filterSections(a: number, b: Ptr, c: Ptr): Ptr;
+        _filterSchedules(a: Ptr, b: number): number;
+        _exportPage(a: number, b: number, c: number): Ptr;
         _getRange(a: number): number;
         _setRefSchedule(a: Ptr): number;
+        _setRenderEvents(a: Ptr): void;
+        _renderSchedule(a: number): Ptr;
         // ------------------------------------------------------------------------
 
         // ------------ APIs of Searcher.cpp --------------------------------------
@@ -55,10 +79,32 @@ declare global {
         _getMatchSize(a: Ptr, b: number): number;
         _getScore(a: Ptr, b: number): number;
         _findBestMatch(a: Ptr, b: Ptr): number;
+        _bm25Search(a: Ptr, b: Ptr, c: number): Ptr;
+        _getNumResults(a: Ptr): number;
+        _autocomplete(a: Ptr, b: Ptr): Ptr;
+        _getToken(a: Ptr, b: number): Ptr;
+        // ------------------------------------------------------------------------
+
+        // ------------ APIs of Trace.cpp -----------------------------------------
+        _dumpTrace(): Ptr;
+        _clearTrace(): void;
+        _traceNow(): number;
+        // ------------------------------------------------------------------------
+
+        // ------------ APIs of MemoryStats.cpp -----------------------------------
+        _getMemoryUsage(): Ptr;
+        _releaseMemory(flags: number): void;
+        _getArenaStats(): Ptr;
         // ------------------------------------------------------------------------
 
         onRuntimeInitialized(): void;
         stringToUTF8(str: string, outPtr: Ptr, maxBytesToWrite: number): void;
+        UTF8ToString(ptr: Ptr): string;
+        /** only present if the module is linked dynamically, see Solver.ts */
+        loadDynamicLibrary?(
+            name: string,
+            flags: { loadAsync: boolean; global: boolean; nodelete: boolean }
+        ): Promise<void>;
         HEAP8: Int8Array;
         HEAP16: Int16Array;
         HEAP32: Int32Array;
@@ -11,6 +11,7 @@ import Event from './Event';
 import ProposedSchedule from './ProposedSchedule';
 import { RawAlgoCourse } from '../algorithm/ScheduleGenerator';
 import { GeneratedError } from '../utils/other';
+import { NativeViewRef } from '../algorithm/Renderer';
 
 const generatedMsg =
     'You are editing a generated schedule, please edit the proposed schedule instead. If you want to keep this particular generated schedule, click "copy" to do so.';
@@ -21,7 +22,7 @@ export default class GeneratedSchedule extends Schedule {
      */
     public All: ScheduleAll<Set<number>[]>;
 
-    constructor(raw: RawAlgoCourse[] = [], events: Event[] = []) {
+    constructor(raw: RawAlgoCourse[] = [], events: Event[] = [], nativeView?: NativeViewRef) {
         const tempAll: GeneratedSchedule['All'] = {};
         for (const [key, sections] of raw) {
             const secs = tempAll[key];
@@ -31,7 +32,7 @@ export default class GeneratedSchedule extends Schedule {
                 tempAll[key] = [new Set(sections)];
             }
         }
-        super(tempAll, events);
+        super(tempAll, events, nativeView);
         this.All = tempAll;
     }
 
@@ -14,7 +14,11 @@ import ScheduleBlock from './ScheduleBlock';
 import Section from './Section';
 import colorSchemes from '@/data/ColorSchemes';
 import ProposedSchedule from './ProposedSchedule';
-import { computeBlockPositions } from '@/algorithm/Renderer';
+import {
+    computeBlockPositions,
+    computeNativeBlockPositions,
+    NativeViewRef
+} from '@/algorithm/Renderer';
 import { dayToInt, Day } from './constants';
 import Meeting from './Meeting';
 import { calcOverlap } from '../utils';
@@ -149,12 +153,18 @@ export default abstract class Schedule {
      * ```
      */
     public dateSeparators: number[] = [];
+    /**
+     * the generated schedule in the native view this schedule is decoded from, if any.
+     * Its blocks are laid out from the native day patterns directly if possible
+     */
+    public nativeView?: NativeViewRef;
 
     /**
      * Construct a `Schedule` object from its raw representation
      */
-    constructor(raw: ScheduleAll = {}, public events: Event[] = []) {
+    constructor(raw: ScheduleAll = {}, public events: Event[] = [], nativeView?: NativeViewRef) {
         this.All = raw;
+        this.nativeView = nativeView;
         if (!this.empty()) {
             this.constructDateSeparator();
             this.computeSchedule();
@@ -332,7 +342,8 @@ export default abstract class Schedule {
         for (const event of this.events) if (event.display) this.place(event, days);
 
         // const tStart = performance.now();
-        await computeBlockPositions(days);
+        if (!this.nativeView || !computeNativeBlockPositions(days, this.nativeView))
+            await computeBlockPositions(days);
         // console.log('compute blocks', performance.now() - tStart);
 
         const totalBlocks = days.reduce((sum, blocks) => sum + blocks.length, 0);
@@ -29,6 +29,9 @@ export interface DisplayState {
     combineSections: boolean;
     maxNumSchedules: number;
     colorScheme: number;
+    sampling: boolean;
+    optimal: boolean;
+    searchBudget: number;
 
     // search options
     expandOnEntering: boolean;
@@ -104,6 +107,10 @@ export class Display implements StoreModule<DisplayState, DisplayState> {
     expandOnEntering = false;
     enableLog = true;
     showWeekend = false;
+    /** sample the schedules uniformly if there are more than maxNumSchedules */
+    sampling = false;
+    /** generate the best schedules first according to the sort options that decompose per section */
+    optimal = false;
 
     private _fullHeight = 40;
     private _partialHeight = 30;
@@ -113,6 +120,8 @@ export class Display implements StoreModule<DisplayState, DisplayState> {
     private _latest = '19:00';
     private _width = 100;
     private _colorScheme = 0;
+    /** time budget of the local search improving a truncated generation, in milliseconds. 0 to disable */
+    private _searchBudget = 0;
 
     // validators
     get fullHeight() {
@@ -139,6 +148,12 @@ export class Display implements StoreModule<DisplayState, DisplayState> {
     set maxNumSchedules(x) {
         this._maxNumSchedules = bound(x, 1000, 5000000);
     }
+    get searchBudget() {
+        return this._searchBudget;
+    }
+    set searchBudget(x) {
+        this._searchBudget = bound(x, 0, 10000);
+    }
     get earliest() {
         return this._earliest;
     }
@@ -24,6 +24,11 @@ interface FilterStateBase {
     readonly timeSlots: TimeSlot[];
     allowWaitlist: boolean;
     allowClosed: boolean;
+    /** keys of the courses that may be left out of the generated schedules */
+    optionalCourses: string[];
+    /** the minimum and maximum number of optional courses taken */
+    minOptional: number;
+    maxOptional: number;
 }
 
 export interface FilterState extends FilterStateBase {
@@ -326,6 +331,9 @@ export class FilterStore implements StoreModule<FilterState, FilterStateJSON> {
     timeSlots: TimeSlot[] = [];
     allowWaitlist = true;
     allowClosed = true;
+    optionalCourses: string[] = [];
+    minOptional = 0;
+    maxOptional = 1;
     sortOptions = getDefaultOptions();
     refSchedule: GeneratedSchedule['All'] = {};
     readonly sortModes = [
@@ -414,6 +422,12 @@ export class FilterStore implements StoreModule<FilterState, FilterStateJSON> {
             typeof obj.allowClosed === 'boolean' ? obj.allowClosed : defaultVal.allowClosed;
         this.allowWaitlist =
             typeof obj.allowWaitlist === 'boolean' ? obj.allowWaitlist : defaultVal.allowWaitlist;
+        this.optionalCourses =
+            obj.optionalCourses instanceof Array ? obj.optionalCourses : defaultVal.optionalCourses;
+        this.minOptional =
+            typeof obj.minOptional === 'number' ? obj.minOptional : defaultVal.minOptional;
+        this.maxOptional =
+            typeof obj.maxOptional === 'number' ? obj.maxOptional : defaultVal.maxOptional;
         this.sortOptions = defaultVal.sortOptions.fromJSON(obj.sortOptions);
 
         const { payload: schedule, level, msg } = ProposedSchedule.fromJSON({
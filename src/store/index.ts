@@ -320,12 +320,19 @@ export default class Store extends Vue {
 
         if (!this.validateSortOptions()) return;
 
+        const { optionalCourses, minOptional, maxOptional } = this.filter;
         return {
             timeSlots,
             status: filteredStatus,
             sortOptions: this.filter.sortOptions,
             combineSections: this.display.combineSections,
-            maxNumSchedules: this.display.maxNumSchedules
+            maxNumSchedules: this.display.maxNumSchedules,
+            sampling: this.display.sampling,
+            optimal: this.display.optimal,
+            searchBudget: this.display.searchBudget,
+            optionalCourses: optionalCourses.length
+                ? { keys: optionalCourses, min: minOptional, max: maxOptional }
+                : undefined
         };
     }
 
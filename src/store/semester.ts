@@ -5,6 +5,7 @@
 /**
  *
  */
+import { prepareCatalogIndex } from '@/algorithm/CatalogIndex';
 import { fallback } from '@/data/Loader';
 import { loadSemesterList } from '@/data/SemesterListLoader';
 import { CancelablePromise } from '@/utils';
@@ -64,6 +65,8 @@ class Semesters implements SemesterState {
         //  if the a catalog object is returned
         if (result.payload) {
             window.catalog = result.payload;
+            // not awaited: the generator works without the index until it is ready, or if it fails
+            prepareCatalogIndex(result.payload);
             this.current = currentSemester;
             this.lastUpdate = new Date(window.catalog.modified).toLocaleString();
         } else {
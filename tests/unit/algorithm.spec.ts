@@ -2,6 +2,24 @@ import Schedule from '@/models/Schedule';
 import Store from '@/store';
 import ProposedSchedule from '@/models/ProposedSchedule';
 import { FastSearcher } from '@/algorithm/Searcher';
+import ScheduleGenerator, {
+    computeSectionCosts,
+    GeneratorOptions
+} from '@/algorithm/ScheduleGenerator';
+import {
+    buildCatalogIndex,
+    exportCatalogIndex,
+    hasCatalogIndex,
+    loadCatalogIndex
+} from '@/algorithm/CatalogIndex';
+import { ExportFlag, FilterOp } from '@/algorithm/ScheduleEvaluator';
+import { getNativeMemoryUsage, releaseNativeMemory, ReleaseFlag } from '@/algorithm/MemoryStats';
+import {
+    computeNativeBlockPositions,
+    layoutStats,
+    options as renderOptions
+} from '@/algorithm/Renderer';
+import { clearNativeTrace, dumpNativeTrace } from '@/algorithm/Trace';
 
 const store = new Store();
 
@@ -46,6 +64,12 @@ describe('ScheduleGenerator Test', () => {
         expect(result!.empty()).toBeFalsy();
         expect(result!.getRange(sort.sortBy[0])).toBeGreaterThan(0.0);
         expect(result!.refSchedule).toEqual({});
+        // a section can only be removed because of a conflict with another course
+        expect(result!.pruned.every(p => p.conflictsWith !== p.section[0])).toBe(true);
+        expect(window.NativeModule._getTotalCount()).toBeGreaterThanOrEqual(result!.size);
+        // a section appears at most once in each schedule
+        expect(result!.sectionCounts.some(c => c > 0)).toBe(true);
+        expect(result!.sectionCounts.every(c => c <= result!.countTotal)).toBe(true);
 
         schedule.addEvent('MoFr 10:00AM - 10:15AM', false);
         schedule.addEvent('MoFr 21:00PM - 22:30PM', false);
@@ -67,6 +91,39 @@ describe('ScheduleGenerator Test', () => {
         sort.mode = 0;
         result4.sort({ newOptions: sort });
         expect(result4.getSchedule(0)).toBeInstanceOf(Schedule);
+        const page = result4.getPage(0, 3, ExportFlag.blocks | ExportFlag.metrics);
+        expect(page.count).toBe(Math.min(3, result4.size));
+        expect(page.blockOffsets![page.count]).toBe(page.blocks!.length);
+
+        // the blocks of a generated schedule are laid out from its day patterns natively
+        const shown = result4.getSchedule(0);
+        expect(computeNativeBlockPositions(shown.days, shown.nativeView!)).toBe(true);
+        for (const blocks of shown.days) {
+            for (const block of blocks) {
+                expect(block.width).toBeGreaterThan(0);
+                expect(block.left + block.width).toBeLessThanOrEqual(1 + 1e-8);
+            }
+        }
+        // with a time budget, the renderer reports the level of the layout it reached
+        renderOptions.budget = 50;
+        expect(computeNativeBlockPositions(shown.days, shown.nativeView!)).toBe(true);
+        expect(layoutStats.level).toBeGreaterThanOrEqual(0);
+        renderOptions.budget = 0;
+
+        // pin a section of the first schedule, then exclude it
+        const total = result4.size;
+        const pinned = Array.from(result4.getSchedule(0).All.cs11105[0])[0];
+        const numPinned = result4.filter([{ op: FilterOp.include, sections: [pinned] }]);
+        expect(numPinned).toBe(result4.size);
+        expect(result4.getSchedule(numPinned - 1).All.cs11105[0].has(pinned)).toBe(true);
+        const numExcluded = result4.filter([{ op: FilterOp.exclude, sections: [pinned] }]);
+        expect(numPinned + numExcluded).toBe(total);
+        expect(result4.filter([])).toBe(total);
+
+        // a sampled preview first, then the exact order in time slices, which is the same as sorting at once
+        const exact = result4.getPage(0, 3).sections.slice();
+        if (window.NativeModule._sortPreview(2) >= 0) while (!window.NativeModule._sortStep(1));
+        expect(result4.getPage(0, 3).sections).toEqual(exact);
 
         sort.mode = 1;
         // only one sort func
@@ -101,11 +158,209 @@ describe('ScheduleGenerator Test', () => {
         sort.sortBy[5].enabled = true;
         r = store.generateSchedules();
         expect(r).toBeTruthy();
+
+        // similarity only: the most similar schedules are generated first
+        const refId = window.catalog.getCourse('cs11105').sections[0].id;
+        for (const sb of sort.sortBy) sb.enabled = sb.name === 'similarity';
+        r = store.generateSchedules();
+        expect(r).toBeTruthy();
+        expect(r!.getSchedule(0).All.cs11105[0].has(refId)).toBe(true);
+
+        const usage = getNativeMemoryUsage();
+        expect(usage.schedules.live).toBeGreaterThan(0);
+        expect(usage.sortCoeffCache.live).toBeGreaterThan(0);
+        // the day patterns are shared by the schedules
+        expect(usage.dayPatterns.live).toBeGreaterThan(0);
+        expect(usage.schedules.peak).toBeGreaterThanOrEqual(usage.schedules.live);
+        releaseNativeMemory(ReleaseFlag.sortCache | ReleaseFlag.shrinkSchedules);
+        expect(getNativeMemoryUsage().sortCoeffCache.live).toBe(0);
+        expect(getNativeMemoryUsage().schedules.live).toBeLessThanOrEqual(usage.schedules.live);
+        // caches are recomputed on demand
+        r!.sort();
+        expect(r!.getSchedule(0)).toBeInstanceOf(Schedule);
+    });
+
+    it('section costs', () => {
+        // two sections on Monday: 8:00 - 8:50 and 12:00 - 12:50
+        const timeArray = new Uint16Array([
+            ...[0, 3, 3, 3, 3, 3, 3, 3],
+            ...[3, 6, 6, 6, 6, 6, 6, 6],
+            ...[480, 530, 0, 720, 770, 0]
+        ]);
+        const sort = store.filter.getDefault().sortOptions;
+        for (const sb of sort.sortBy) sb.enabled = sb.name === 'noEarly';
+        const costs = new Float32Array(2);
+        expect(computeSectionCosts(timeArray, [0, 2], sort, null, costs)).toBe(true);
+        expect(Array.from(costs)).toEqual([1, 0]);
+
+        for (const sb of sort.sortBy) sb.enabled = sb.name === 'lunchTime';
+        computeSectionCosts(timeArray, [0, 2], sort, null, costs);
+        expect(Array.from(costs)).toEqual([0, 1]);
+
+        // compactness does not decompose per section
+        for (const sb of sort.sortBy) sb.enabled = sb.name === 'compactness';
+        expect(computeSectionCosts(timeArray, [0, 2], sort, null, costs)).toBe(false);
+    });
+
+    it('catalog index', () => {
+        store.filter.timeSlots.length = 0;
+        store.filter.refSchedule = {};
+        store.schedule.proposedSchedules[
+            store.schedule.proposedScheduleIndex
+        ] = new ProposedSchedule(
+            global.convertAll({ cs11105: -1, cs11104: -1, ece23305: -1, apma31105: -1 })
+        );
+        const r1 = store.generateSchedules();
+        expect(r1).toBeTruthy();
+        const size = r1!.size,
+            total = window.NativeModule._getTotalCount();
+
+        buildCatalogIndex(window.catalog);
+        expect(hasCatalogIndex(window.catalog)).toBe(true);
+        expect(getNativeMemoryUsage().catalogIndex.live).toBeGreaterThan(0);
+        const file = exportCatalogIndex();
+        expect(loadCatalogIndex(window.catalog, file.slice(0, file.length - 4))).toBe(false);
+        expect(hasCatalogIndex(window.catalog)).toBe(false);
+        expect(loadCatalogIndex(window.catalog, file)).toBe(true);
+
+        // the inputs gathered from the index and the conflicts looked up from it are the same as the computed ones
+        const r2 = store.generateSchedules();
+        expect(r2!.size).toBe(size);
+        expect(window.NativeModule._getTotalCount()).toBe(total);
+    });
+
+    it('optional courses', () => {
+        store.filter.timeSlots.length = 0;
+        store.filter.refSchedule = {};
+        const schedule = new ProposedSchedule(
+            global.convertAll({ cs11105: -1, cs11104: -1, ece23305: -1 })
+        );
+        const generator = new ScheduleGenerator(window.catalog, window.timeMatrix, {
+            ...store.getGeneratorOptions()!,
+            optionalCourses: { keys: ['cs11104', 'ece23305'], min: 1, max: 1 }
+        });
+        const result = generator.getSchedules(schedule).payload!;
+        expect(result.size).toBeGreaterThan(0);
+        // exactly one of the optional courses is taken
+        for (let i = 0; i < Math.min(result.size, 20); i++) {
+            const keys = Object.keys(result.getSchedule(i).All);
+            expect(keys).toContain('cs11105');
+            expect(keys.length).toBe(2);
+        }
+
+        // without limits, the schedules are counted exactly: those without the optional course plus those with it
+        const countOf = (
+            courses: ProposedSchedule,
+            optionalCourses?: GeneratorOptions['optionalCourses']
+        ) => {
+            const gen = new ScheduleGenerator(window.catalog, window.timeMatrix, {
+                ...store.getGeneratorOptions()!,
+                optionalCourses
+            });
+            expect(gen.getSchedules(courses).payload).toBeTruthy();
+            return window.NativeModule._getTotalCount();
+        };
+        const without = countOf(
+            new ProposedSchedule(global.convertAll({ cs11105: -1, ece23305: -1 }))
+        );
+        const required = countOf(
+            new ProposedSchedule(global.convertAll({ cs11105: -1, cs11104: -1, ece23305: -1 }))
+        );
+        const total = countOf(schedule, { keys: ['cs11104'], min: 0, max: 1 });
+        expect(total).toBeGreaterThan(0);
+        expect(total).toBe(without + required);
+
+        // an optional course whose only section is blocked by the events is never taken,
+        // and the courses after it are generated as if it were not there
+        const blocked = window.catalog
+            .getCourse('cs11104')
+            .sections.findIndex(s => !s.isTBD() && s.meetings.some(m => m.days));
+        expect(blocked).toBeGreaterThanOrEqual(0);
+        const withEvents = (courses: ProposedSchedule) => {
+            const { meetings } = window.catalog.getCourse('cs11104').sections[blocked];
+            for (const d of new Set(meetings.map(m => m.days).filter(d => d)))
+                courses.addEvent(d, false);
+            return courses;
+        };
+        const rest = countOf(
+            withEvents(new ProposedSchedule(global.convertAll({ cs11105: -1, ece23305: -1 })))
+        );
+        const withBlocked = countOf(
+            withEvents(
+                new ProposedSchedule(
+                    global.convertAll({ cs11104: new Set([blocked]), cs11105: -1, ece23305: -1 })
+                )
+            ),
+            { keys: ['cs11104'], min: 0, max: 1 }
+        );
+        expect(withBlocked).toBe(rest);
+
+        // limits that cannot be satisfied are rejected
+        const bad = new ScheduleGenerator(window.catalog, window.timeMatrix, {
+            ...store.getGeneratorOptions()!,
+            optionalCourses: { keys: ['cs11104'], min: 2, max: 1 }
+        });
+        expect(bad.getSchedules(schedule).level).toBe('error');
+        bad.options.optionalCourses!.max = 2;
+        expect(bad.getSchedules(schedule).level).toBe('error');
+
+        // the optional courses marked in the filter are passed to the generator
+        store.filter.optionalCourses = ['cs11104'];
+        expect(store.getGeneratorOptions()!.optionalCourses).toEqual({
+            keys: ['cs11104'],
+            min: 0,
+            max: 1
+        });
+        store.filter.optionalCourses = [];
+        expect(store.getGeneratorOptions()!.optionalCourses).toBeUndefined();
+    });
+
+    it('trace', () => {
+        clearNativeTrace();
+        expect(dumpNativeTrace().traceEvents).toEqual([]);
+        expect(store.generateSchedules()).toBeTruthy();
+        // the spans of the TS wrappers are recorded with the native ones if tracing is enabled
+        const enabled = window.NativeModule._traceNow() >= 0;
+        const names = dumpNativeTrace().traceEvents.map((e: any) => e.name);
+        expect(names.includes('ScheduleGenerator.getSchedules::generate')).toBe(enabled);
+        expect(names.includes('ScheduleGenerator::generate')).toBe(enabled);
     });
 
     it('searcher', () => {
         const searcher = new FastSearcher(['building number 1', 'a great building']);
         const [idx] = searcher.findBestMatch('build num 1');
         expect(idx).toBe(0);
+
+        const courses = new FastSearcher([
+            'introduction to programming',
+            'introduction to algorithms',
+            'advanced algorithms'
+        ]);
+        const results = courses.bm25Search('introduction algorithms', 2);
+        expect(results.length).toBe(2);
+        expect(results[0].index).toBe(1);
+        expect(results[0].score).toBeGreaterThan(results[1].score);
+        expect(courses.bm25Search('nonexistent', 2).length).toBe(0);
+
+        const { completions, indices } = courses.autocomplete('intro to algo');
+        expect(completions).toEqual(['algorithms']);
+        expect(indices).toEqual([1, 2]);
+        expect(courses.autocomplete('intr').completions).toEqual(['introduction']);
+        expect(courses.autocomplete('xyz').completions.length).toBe(0);
+
+        // sentences are ranked by the most popular completion they contain, among all completions of the prefix
+        const items = new FastSearcher([
+            'ab ac ad ae af ag ah ai aj',
+            'ak',
+            'al x',
+            'al y',
+            'café crème'
+        ]);
+        const ranked = items.autocomplete('a');
+        expect(ranked.completions[0]).toBe('al');
+        expect(ranked.indices).toEqual([2, 3, 0, 1]);
+        // non-ASCII prefixes
+        expect(items.autocomplete('caf').completions).toEqual(['café']);
+        expect(items.autocomplete('crè').indices).toEqual([4]);
     });
 });
@@ -42,3 +42,37 @@ test.skip('algorithm benchmark', () => {
     }
     console.info('Average', total / num + 's');
 });
+
+test.skip('evaluation layout benchmark', () => {
+    store.display.maxNumSchedules = 2000000;
+    const options = store.getGeneratorOptions();
+    if (!options) throw new Error('failed to get options');
+    const generator = new ScheduleGenerator(window.catalog, window.timeMatrix, options);
+    const schedule = new ProposedSchedule({
+        cs11105: -1,
+        cs11104: -1,
+        enwr15107: -1,
+        econ20105: -1,
+        econ20101: -1,
+        chem14105: -1,
+        chem14101: -1,
+        cs21025: -1,
+        apma31105: -1,
+        phys24194: -1
+    });
+    const sort = options.sortOptions;
+    // 0: interleaved, 1: split
+    for (const layout of [0, 1]) {
+        window.NativeModule._setEvalLayout(layout);
+        const { payload: result } = generator.getSchedules(schedule);
+        expect(result!.empty()).toBeFalsy();
+        for (const sb of sort.sortBy) {
+            if (sb.name === 'similarity' || sb.name === 'IamFeelingLucky') continue;
+            for (const other of sort.sortBy) other.enabled = other === sb;
+            const start = performance.now();
+            result!.sort({ newOptions: sort });
+            console.info('layout', layout, sb.name, result!.size, performance.now() - start + 'ms');
+        }
+    }
+    window.NativeModule._setEvalLayout(1);
+});